@@ -0,0 +1,48 @@
+/**
+ * AssetImage.h
+ *
+ * Layout of the web asset image stored in the "assets" flash partition and
+ * produced by tools/build_assets.py. All integers are little-endian.
+ *
+ *   AssetImageHeader
+ *   AssetEntry[count]
+ *   file data, each file starting on a 4-byte boundary
+ *
+ * Offsets are relative to the start of the image. The firmware maps the
+ * image with esp_partition_mmap() and serves file data straight from flash.
+ */
+
+#ifndef ASSET_IMAGE_H
+#define ASSET_IMAGE_H
+
+#include <stdint.h>
+
+const uint32_t assetImageMagic = 0x3141584E; // "NXA1"
+const uint16_t assetImageVersion = 1;
+const uint8_t assetPartitionSubtype = 0x40;  // Custom data subtype in partitions.csv
+
+const int assetPathMax = 40;
+const int assetMimeMax = 24;
+
+const uint32_t assetFlagGzip = 0x01;
+
+struct AssetImageHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+  uint32_t imageSize;  // Header, entries and data
+  uint32_t reserved;
+};
+
+struct AssetEntry {
+  char path[assetPathMax];   // URL path, NUL-terminated, e.g. "/style.css"
+  char mime[assetMimeMax];   // Content-Type, NUL-terminated
+  uint32_t offset;
+  uint32_t length;
+  uint32_t flags;
+};
+
+static_assert(sizeof(AssetImageHeader) == 16, "asset header layout");
+static_assert(sizeof(AssetEntry) == 76, "asset entry layout");
+
+#endif // ASSET_IMAGE_H
@@ -0,0 +1,59 @@
+/**
+ * CivilTime.h
+ *
+ * Conversions between seconds since 1970-01-01 UTC and calendar fields that
+ * work on 64-bit values. The ESP32 toolchain's time_t is 32 bits, so gmtime()
+ * stops in 2038; the synthetic time generator needs dates up to and beyond
+ * 2100. Uses the proleptic Gregorian days-from-civil algorithm (H. Hinnant).
+ */
+
+#ifndef CIVIL_TIME_H
+#define CIVIL_TIME_H
+
+#include <stdint.h>
+#include <time.h>
+
+inline int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = (unsigned)(y - era * 400);
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int64_t)doe - 719468;
+}
+
+inline int64_t epochFromCivil(int64_t y, unsigned m, unsigned d, unsigned hh, unsigned mm, unsigned ss) {
+  return daysFromCivil(y, m, d) * 86400 + hh * 3600 + mm * 60 + ss;
+}
+
+// Fills the same fields gmtime() would (tm_year is years since 1900)
+inline void civilFromEpoch(int64_t secs, struct tm &out) {
+  int64_t days = secs / 86400;
+  int64_t rem = secs % 86400;
+  if (rem < 0) {
+    rem += 86400;
+    days--;
+  }
+  out.tm_hour = (int)(rem / 3600);
+  out.tm_min = (int)(rem % 3600 / 60);
+  out.tm_sec = (int)(rem % 60);
+  out.tm_wday = (int)((days + 4) % 7 + ((days + 4) % 7 < 0 ? 7 : 0));
+
+  const int64_t z = days + 719468;
+  const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const unsigned doe = (unsigned)(z - era * 146097);
+  const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+  const unsigned d = doy - (153 * mp + 2) / 5 + 1;
+  const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+  const int64_t y = (int64_t)yoe + era * 400 + (m <= 2);
+
+  out.tm_year = (int)(y - 1900);
+  out.tm_mon = (int)m - 1;
+  out.tm_mday = (int)d;
+  out.tm_yday = (int)(days - daysFromCivil(y, 1, 1));
+  out.tm_isdst = 0;
+}
+
+#endif // CIVIL_TIME_H
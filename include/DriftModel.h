@@ -0,0 +1,159 @@
+/**
+ * DriftModel.h
+ *
+ * Learned frequency correction of the system clock as a function of the
+ * chip's temperature, for holding time between NTP syncs and through WiFi
+ * outages. The crystal's frequency error follows temperature, so one drift
+ * value learned at night is wrong by the afternoon.
+ *
+ * The model is a row of temperature bins, each holding the correction (in
+ * parts per billion, positive = the clock runs slow and must be advanced)
+ * that kept the clock right while the chip was at that temperature. Between
+ * syncs the time spent in each bin is accumulated in a DriftInterval; at
+ * the next sync the residual error is spread over the bins in proportion to
+ * that dwell time (normalised LMS), so an interval that crossed several
+ * temperatures trains all of them. Bins without data are interpolated from
+ * their learned neighbours.
+ *
+ * The model is a fixed-size struct so it can be stored as one NVS blob.
+ */
+
+#ifndef DRIFT_MODEL_H
+#define DRIFT_MODEL_H
+
+#include <stdint.h>
+
+const int driftBinCount = 20;
+const float driftBinMinC = 10.0f;     // Lower edge of the first bin (die temperature)
+const float driftBinWidthC = 4.0f;
+const uint32_t driftDefaultPpb = 20000;  // Assumed error bound of an unlearned bin
+
+struct DriftBin {
+  int32_t ppb;        // Correction that keeps the clock right at this temperature
+  uint16_t samples;
+  uint16_t madPpb;    // Smoothed absolute residual, the bin's uncertainty
+};
+
+struct DriftModel {
+  DriftBin bins[driftBinCount];
+};
+
+static_assert(sizeof(DriftModel) == 160, "drift model blob layout");
+
+struct DriftInterval {
+  uint32_t dwellMs[driftBinCount];
+  int64_t appliedNs;  // Correction slewed into the clock during the interval
+};
+
+inline int driftBinFor(float tempC) {
+  int b = (int)((tempC - driftBinMinC) / driftBinWidthC);
+  if (tempC < driftBinMinC || b < 0) return 0;
+  return b >= driftBinCount ? driftBinCount - 1 : b;
+}
+
+inline float driftBinCenterC(int b) {
+  return driftBinMinC + (b + 0.5f) * driftBinWidthC;
+}
+
+inline bool driftBinLearned(const DriftBin &bin) {
+  return bin.samples > 0;
+}
+
+// Correction for `tempC`: the bin's own value when learned, otherwise
+// interpolated between (or held from) the nearest learned bins. Returns false
+// if nothing has been learned yet. `uncertaintyPpb` (optional) grows when the
+// value had to be interpolated and more so when extrapolated.
+inline bool driftModelLookup(const DriftModel &m, float tempC, int32_t &ppb, uint32_t *uncertaintyPpb = 0) {
+  int b = driftBinFor(tempC);
+  if (driftBinLearned(m.bins[b])) {
+    ppb = m.bins[b].ppb;
+    if (uncertaintyPpb) *uncertaintyPpb = m.bins[b].madPpb;
+    return true;
+  }
+  int lo = b - 1;
+  while (lo >= 0 && !driftBinLearned(m.bins[lo])) lo--;
+  int hi = b + 1;
+  while (hi < driftBinCount && !driftBinLearned(m.bins[hi])) hi++;
+  bool haveLo = lo >= 0;
+  bool haveHi = hi < driftBinCount;
+  if (!haveLo && !haveHi) return false;
+  if (haveLo && haveHi) {
+    float t = (tempC - driftBinCenterC(lo)) / (driftBinCenterC(hi) - driftBinCenterC(lo));
+    if (t < 0) t = 0;
+    if (t > 1) t = 1;
+    ppb = (int32_t)(m.bins[lo].ppb + t * (m.bins[hi].ppb - m.bins[lo].ppb));
+    uint32_t mad = m.bins[lo].madPpb > m.bins[hi].madPpb ? m.bins[lo].madPpb : m.bins[hi].madPpb;
+    if (uncertaintyPpb) *uncertaintyPpb = 2 * mad + 500 * (uint32_t)(hi - lo - 1);
+  } else {
+    const DriftBin &n = m.bins[haveLo ? lo : hi];
+    int dist = haveLo ? b - lo : hi - b;
+    ppb = n.ppb;
+    if (uncertaintyPpb) *uncertaintyPpb = 4 * (uint32_t)n.madPpb + 2000 * (uint32_t)dist;
+  }
+  return true;
+}
+
+inline void driftIntervalReset(DriftInterval &iv) {
+  for (int b = 0; b < driftBinCount; b++) iv.dwellMs[b] = 0;
+  iv.appliedNs = 0;
+}
+
+inline void driftIntervalAdd(DriftInterval &iv, float tempC, uint32_t ms, int64_t appliedNs) {
+  iv.dwellMs[driftBinFor(tempC)] += ms;
+  iv.appliedNs += appliedNs;
+}
+
+inline uint32_t driftIntervalMs(const DriftInterval &iv) {
+  uint32_t total = 0;
+  for (int b = 0; b < driftBinCount; b++) total += iv.dwellMs[b];
+  return total;
+}
+
+// Trains the model with the residual error measured at a sync: the clock
+// was off by `residualUs` (true minus local) after the interval's applied
+// correction. Intervals under a minute are too short to tell drift from
+// network jitter and are ignored. Returns the residual rate in ppb.
+inline int32_t driftModelLearn(DriftModel &m, const DriftInterval &iv, int64_t residualUs) {
+  uint32_t totalMs = driftIntervalMs(iv);
+  if (totalMs < 60000) return 0;
+  int64_t errPpb64 = residualUs * 1000000 / (int64_t)totalMs;
+  if (errPpb64 > 1000000) errPpb64 = 1000000;
+  if (errPpb64 < -1000000) errPpb64 = -1000000;
+  float err = (float)errPpb64;
+
+  float w[driftBinCount];
+  float sumSq = 0;
+  for (int b = 0; b < driftBinCount; b++) {
+    w[b] = (float)iv.dwellMs[b] / totalMs;
+    sumSq += w[b] * w[b];
+  }
+  // Fresh bins start from what was applied while there (the interpolated
+  // value), taken before any bin changes
+  bool fresh[driftBinCount];
+  int32_t start[driftBinCount];
+  for (int b = 0; b < driftBinCount; b++) {
+    fresh[b] = w[b] > 0 && m.bins[b].samples == 0;
+    start[b] = 0;
+    if (fresh[b]) driftModelLookup(m, driftBinCenterC(b), start[b]);
+  }
+  for (int b = 0; b < driftBinCount; b++) {
+    if (w[b] == 0) continue;
+    DriftBin &bin = m.bins[b];
+    if (fresh[b]) {
+      bin.ppb = start[b];
+      bin.madPpb = (uint16_t)(driftDefaultPpb / 4);
+    }
+    // Step size 1 / (n + 1) until the bin has a few samples, then 1/8
+    float mu = bin.samples < 7 ? 1.0f / (bin.samples + 1) : 0.125f;
+    bin.ppb += (int32_t)(mu * err * w[b] / sumSq);
+    if (!fresh[b] && w[b] >= 0.25f) {
+      float absErr = err < 0 ? -err : err;
+      float mad = bin.madPpb + (absErr - bin.madPpb) / 4;
+      bin.madPpb = mad > 65535 ? 65535 : (uint16_t)mad;
+    }
+    if (w[b] >= 0.1f && bin.samples < 0xFFFF) bin.samples++;
+  }
+  return (int32_t)errPpb64;
+}
+
+#endif // DRIFT_MODEL_H
@@ -0,0 +1,132 @@
+/**
+ * FastFormat.h
+ *
+ * Small sprintf replacement for the hot paths (NMEA fields, checksums, the
+ * clock text on the display). Everything writes into a caller-supplied
+ * buffer through FmtBuf, never allocates and keeps the buffer NUL-terminated.
+ * On overflow the output is truncated and FmtBuf::overflow is set. Buffers
+ * must hold at least one byte.
+ */
+
+#ifndef FAST_FORMAT_H
+#define FAST_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// "00" .. "99", two characters per entry
+static const char fmtDigitPairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char fmtHexDigits[17] = "0123456789ABCDEF";
+
+struct FmtBuf {
+  char *start;
+  char *pos;
+  char *end;      // Last usable byte, reserved for the terminating NUL
+  bool overflow;
+
+  FmtBuf(char *buf, size_t size) : start(buf), pos(buf), end(buf + size - 1), overflow(false) {
+    *pos = '\0';
+  }
+
+  size_t length() const { return (size_t)(pos - start); }
+  size_t remaining() const { return (size_t)(end - pos); }
+};
+
+inline void fmtChar(FmtBuf &b, char c) {
+  if (b.pos >= b.end) {
+    b.overflow = true;
+    return;
+  }
+  *b.pos++ = c;
+  *b.pos = '\0';
+}
+
+inline void fmtStr(FmtBuf &b, const char *s) {
+  while (*s != '\0') {
+    if (b.pos >= b.end) {
+      b.overflow = true;
+      break;
+    }
+    *b.pos++ = *s++;
+  }
+  *b.pos = '\0';
+}
+
+inline void fmtMem(FmtBuf &b, const char *s, size_t n) {
+  if (n > b.remaining()) {
+    n = b.remaining();
+    b.overflow = true;
+  }
+  for (size_t i = 0; i < n; i++) b.pos[i] = s[i];
+  b.pos += n;
+  *b.pos = '\0';
+}
+
+// Two digits, zero-padded ("%02u" for 0..99; larger values keep the last two)
+inline void fmt2(FmtBuf &b, unsigned v) {
+  fmtMem(b, &fmtDigitPairs[(v % 100) * 2], 2);
+}
+
+// Unsigned decimal, zero-padded to at least `width` digits ("%0*lu")
+inline void fmtUint(FmtBuf &b, uint32_t v, int width = 0) {
+  char tmp[10];
+  int n = 0;
+  while (v >= 100) {
+    unsigned pair = v % 100;
+    v /= 100;
+    tmp[n++] = fmtDigitPairs[pair * 2 + 1];
+    tmp[n++] = fmtDigitPairs[pair * 2];
+  }
+  if (v >= 10) {
+    tmp[n++] = fmtDigitPairs[v * 2 + 1];
+    tmp[n++] = fmtDigitPairs[v * 2];
+  } else {
+    tmp[n++] = (char)('0' + v);
+  }
+  for (int i = n; i < width; i++) fmtChar(b, '0');
+  while (n > 0) fmtChar(b, tmp[--n]);
+}
+
+// Signed decimal, zero-padded to at least `width` characters including the
+// sign ("%0*ld")
+inline void fmtInt(FmtBuf &b, int32_t v, int width = 0) {
+  if (v < 0) {
+    fmtChar(b, '-');
+    fmtUint(b, (uint32_t)0 - (uint32_t)v, width - 1);
+  } else {
+    fmtUint(b, (uint32_t)v, width);
+  }
+}
+
+// Fixed-point decimal: `scaled` holds the value times 10^decimals, so
+// fmtFixed(b, 1234, 2) writes "12.34" and fmtFixed(b, -5, 1) writes "-0.5".
+inline void fmtFixed(FmtBuf &b, int32_t scaled, int decimals, int intWidth = 0) {
+  uint32_t div = 1;
+  for (int i = 0; i < decimals; i++) div *= 10;
+  uint32_t mag = scaled < 0 ? (uint32_t)0 - (uint32_t)scaled : (uint32_t)scaled;
+  if (scaled < 0) fmtChar(b, '-');
+  fmtUint(b, mag / div, intWidth);
+  if (decimals > 0) {
+    fmtChar(b, '.');
+    fmtUint(b, mag % div, decimals);
+  }
+}
+
+// Two uppercase hex digits ("%02X")
+inline void fmtHex2(FmtBuf &b, uint8_t v) {
+  char hex[2] = {fmtHexDigits[v >> 4], fmtHexDigits[v & 0x0F]};
+  fmtMem(b, hex, 2);
+}
+
+#endif // FAST_FORMAT_H
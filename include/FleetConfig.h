@@ -0,0 +1,143 @@
+/**
+ * FleetConfig.h
+ *
+ * Wire format of the fleet configuration push: a settings delta sent to a
+ * multicast group, signed with a key shared by the fleet, and the compact
+ * acknowledgement each unit returns to the sender.
+ *
+ * Push (little-endian, at most fleetPacketMax bytes):
+ *
+ *   0   4  magic "NGFC"
+ *   4   1  format (1)
+ *   5   1  number of entries
+ *   6   4  version this delta brings the unit to
+ *   10  4  base version: the delta holds every change made since it
+ *   14  .. entries: key id, value length, value text (as for 'set')
+ *   -32 32 HMAC-SHA256 over everything before it
+ *
+ * A unit applies a delta when its own version is at least the base and
+ * below the new version, so a sender can always roll out one cumulative
+ * delta from the oldest version still in the field, and repeating a packet
+ * (bursts against loss) is harmless. Old packets replayed later are
+ * ignored for the same reason.
+ *
+ * Ack (16 bytes): magic "NGFA", status, format, the unit's station MAC and
+ * its version after handling the push. Packets that are malformed or fail
+ * the signature check get no reply.
+ *
+ * The HMAC itself is computed by the caller.
+ */
+
+#ifndef FLEET_CONFIG_H
+#define FLEET_CONFIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+const uint8_t fleetFormat = 1;
+const size_t fleetHeaderSize = 14;
+const size_t fleetMacSize = 32;       // HMAC-SHA256
+const size_t fleetKeySize = 32;
+const size_t fleetPacketMax = 512;
+const size_t fleetAckSize = 16;
+const int fleetEntriesMax = 8;
+const uint8_t fleetValueMax = 63;     // Longest NTP server name accepted
+
+// Settings a push may carry; the names are those of the console's 'set'.
+// The hostname is per unit and deliberately not among them.
+enum FleetKey : uint8_t {
+  FLEET_KEY_NONE, FLEET_KEY_NTP, FLEET_KEY_BAUD, FLEET_KEY_NMEA, FLEET_KEY_NTPPS,
+  FLEET_KEY_ROTATION, FLEET_KEY_COUNT
+};
+const char *const fleetKeyNames[FLEET_KEY_COUNT] = {"", "ntp", "baud", "nmea", "ntpps", "rotation"};
+
+enum FleetAckStatus : uint8_t {
+  FLEET_ACK_APPLIED,   // Delta applied, now at its version
+  FLEET_ACK_CURRENT,   // Already at or past the delta's version
+  FLEET_ACK_GAP,       // Older than the delta's base: needs a delta from an earlier base
+  FLEET_ACK_REJECTED,  // A value was invalid; nothing was applied
+  FLEET_ACK_STATUS_COUNT
+};
+const char *const fleetAckNames[FLEET_ACK_STATUS_COUNT] = {"applied", "current", "gap", "rejected"};
+
+struct FleetEntry {
+  uint8_t key;
+  uint8_t len;
+  const uint8_t *value;  // Points into the packet, not terminated
+};
+
+struct FleetDelta {
+  uint32_t version;
+  uint32_t base;
+  int count;
+  FleetEntry entries[fleetEntriesMax];
+};
+
+inline uint32_t fleetReadU32(const uint8_t *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+inline void fleetWriteU32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+// Cheap checks before the HMAC is computed
+inline bool fleetLooksValid(const uint8_t *p, size_t len) {
+  return len >= fleetHeaderSize + fleetMacSize && len <= fleetPacketMax && memcmp(p, "NGFC", 4) == 0 &&
+         p[4] == fleetFormat;
+}
+
+// Bytes covered by the signature
+inline size_t fleetSignedLength(size_t len) {
+  return len - fleetMacSize;
+}
+
+// Constant time, so the check does not reveal how much of a forged MAC matched
+inline bool fleetMacEqual(const uint8_t *a, const uint8_t *b) {
+  uint8_t diff = 0;
+  for (size_t i = 0; i < fleetMacSize; i++) diff |= a[i] ^ b[i];
+  return diff == 0;
+}
+
+// Splits a signed packet into its entries. Fails on unknown keys, values
+// that are empty or too long, and trailing bytes.
+inline bool fleetParse(const uint8_t *p, size_t len, FleetDelta &out) {
+  if (!fleetLooksValid(p, len)) return false;
+  out.count = p[5];
+  if (out.count > fleetEntriesMax) return false;
+  out.version = fleetReadU32(p + 6);
+  out.base = fleetReadU32(p + 10);
+  if (out.base >= out.version) return false;
+  size_t end = fleetSignedLength(len);
+  size_t off = fleetHeaderSize;
+  for (int i = 0; i < out.count; i++) {
+    if (off + 2 > end) return false;
+    FleetEntry &e = out.entries[i];
+    e.key = p[off];
+    e.len = p[off + 1];
+    e.value = p + off + 2;
+    if (e.key == FLEET_KEY_NONE || e.key >= FLEET_KEY_COUNT || e.len == 0 || e.len > fleetValueMax) return false;
+    off += 2 + e.len;
+    if (off > end) return false;
+  }
+  return off == end;
+}
+
+// What a unit at `current` does with the delta, short of validating values
+inline FleetAckStatus fleetVersionCheck(uint32_t current, const FleetDelta &d) {
+  if (current >= d.version) return FLEET_ACK_CURRENT;
+  if (current < d.base) return FLEET_ACK_GAP;
+  return FLEET_ACK_APPLIED;
+}
+
+inline size_t fleetEncodeAck(uint8_t *out, FleetAckStatus status, const uint8_t mac[6], uint32_t version) {
+  memcpy(out, "NGFA", 4);
+  out[4] = status;
+  out[5] = fleetFormat;
+  memcpy(out + 6, mac, 6);
+  fleetWriteU32(out + 12, version);
+  return fleetAckSize;
+}
+
+#endif // FLEET_CONFIG_H
@@ -0,0 +1,47 @@
+/**
+ * InputTrace.h
+ *
+ * Record format of the on-device input capture, shared with the host
+ * replayer in tools/replay. A trace is a sequence of records:
+ *
+ *   uint8_t  type     (InputType)
+ *   uint8_t  len      payload length
+ *   uint32_t ms       millis() when the input arrived, little-endian
+ *   uint8_t  payload[len]
+ *
+ * Payloads, all little-endian:
+ *   INPUT_WIFI_UP      channel u8, rssi i8, ipv4 u32 (network order bytes)
+ *   INPUT_WIFI_DOWN    reason u8
+ *   INPUT_NTP_SAMPLE   rttUs u32, correctionUs i64
+ *   INPUT_HTTP         method u8 (1 = GET, 2 = POST), "uri?k=v&..." (no NUL;
+ *                      the password argument is never recorded)
+ *   INPUT_BUTTON       level u8 (0 = pressed)
+ *   INPUT_SCAN         count u8, then per network: rssi i8, channel u8,
+ *                      ssid length u8, ssid bytes
+ *   INPUT_FLEET        more u8, sender ipv4 u32 (network order bytes), sender
+ *                      port u16, length u16 as received (may exceed what was
+ *                      read), packet bytes; a packet too long for one record
+ *                      continues in the next INPUT_FLEET record (more = 1 on
+ *                      all but the last)
+ */
+
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include <stdint.h>
+
+enum InputType : uint8_t {
+  INPUT_WIFI_UP = 1,
+  INPUT_WIFI_DOWN = 2,
+  INPUT_NTP_SAMPLE = 3,
+  INPUT_HTTP = 4,
+  INPUT_BUTTON = 5,
+  INPUT_SCAN = 6,
+  INPUT_FLEET = 7,
+};
+
+const int inputRecordHeaderSize = 6;
+const int inputPayloadMax = 255;
+const int inputFleetHeaderSize = 9;
+
+#endif // INPUT_TRACE_H
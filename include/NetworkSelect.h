@@ -0,0 +1,86 @@
+/**
+ * NetworkSelect.h
+ *
+ * Per-network connection history and the scoring used to pick which saved
+ * WiFi network to try next.
+ */
+
+#ifndef NETWORK_SELECT_H
+#define NETWORK_SELECT_H
+
+#include <stdint.h>
+
+// Persisted as a blob, so keep it fixed-size
+struct NetworkStats {
+  uint16_t attempts;
+  uint16_t successes;
+  uint32_t avgConnectMs;  // EWMA of time-to-connect, successful attempts only
+  uint32_t avgNtpRttUs;   // EWMA of NTP round-trip time on this network
+  uint16_t rttSamples;
+  uint16_t reserved;
+};
+
+const int8_t networkNotVisible = -128;
+const uint16_t networkHistoryMax = 200;   // Halve counts beyond this to stay adaptive
+const uint32_t networkDefaultConnectMs = 8000;
+const uint32_t networkDefaultRttUs = 50000;
+
+inline void networkAgeHistory(NetworkStats &st) {
+  if (st.attempts >= networkHistoryMax) {
+    st.attempts /= 2;
+    st.successes /= 2;
+  }
+}
+
+inline void networkRecordAttempt(NetworkStats &st) {
+  networkAgeHistory(st);
+  st.attempts++;
+}
+
+inline void networkRecordConnect(NetworkStats &st, uint32_t connectMs) {
+  st.successes++;
+  if (st.successes > st.attempts) st.successes = st.attempts;
+  st.avgConnectMs = st.successes == 1 ? connectMs : (st.avgConnectMs * 3 + connectMs) / 4;
+}
+
+inline void networkRecordRtt(NetworkStats &st, uint32_t rttUs) {
+  st.avgNtpRttUs = st.rttSamples == 0 ? rttUs : (st.avgNtpRttUs * 7 + rttUs) / 8;
+  if (st.rttSamples < 0xFFFF) st.rttSamples++;
+}
+
+// Expected cost of trying a network, lower is better: the time to get a
+// connection divided by the (smoothed) chance of getting one, plus a penalty
+// for poor NTP round-trip times and for weak signal.
+inline uint32_t networkScore(const NetworkStats &st, int8_t rssi) {
+  uint32_t connectMs = st.successes ? st.avgConnectMs : networkDefaultConnectMs;
+  uint32_t rttUs = st.rttSamples ? st.avgNtpRttUs : networkDefaultRttUs;
+  // Laplace-smoothed success rate in 1/1000
+  uint32_t rate = (uint32_t)(st.successes + 1) * 1000 / (st.attempts + 2);
+  uint32_t score = connectMs * 1000 / rate;
+  score += rttUs / 10;  // 10 ms of RTT weighs like 1 s of connect time
+  if (rssi != networkNotVisible && rssi < -80) score += 4000;
+  return score;
+}
+
+// Picks the best of `count` networks. rssi[i] is networkNotVisible for
+// networks missing from the last scan; those are only considered when none
+// is visible. Returns -1 if count is 0.
+inline int networkSelect(const NetworkStats *stats, const int8_t *rssi, int count) {
+  int best = -1;
+  uint32_t bestScore = 0;
+  bool anyVisible = false;
+  for (int i = 0; i < count; i++) {
+    if (rssi[i] != networkNotVisible) anyVisible = true;
+  }
+  for (int i = 0; i < count; i++) {
+    if (anyVisible && rssi[i] == networkNotVisible) continue;
+    uint32_t score = networkScore(stats[i], rssi[i]);
+    if (best < 0 || score < bestScore) {
+      best = i;
+      bestScore = score;
+    }
+  }
+  return best;
+}
+
+#endif // NETWORK_SELECT_H
@@ -0,0 +1,120 @@
+/**
+ * TimeQuality.h
+ *
+ * Estimates how far the system clock may be off and maps that onto the NMEA
+ * fields receivers use to judge a fix: RMC status and mode indicator, GGA fix
+ * quality, satellite count and HDOP, and the GSA fix mode.
+ *
+ * The error bound is half the last NTP round trip (the asymmetry it could
+ * hide) plus the drift accumulated since that sync. The drift rate comes from
+ * the last slew correction divided by the interval it built up over; until
+ * one has been seen a typical crystal tolerance is assumed.
+ */
+
+#ifndef TIME_QUALITY_H
+#define TIME_QUALITY_H
+
+#include <stdint.h>
+
+enum TimeSource : uint8_t {
+  TIME_SOURCE_NONE,       // Clock not plausible
+  TIME_SOURCE_RTC,        // Kept across a restart, not synced since boot
+  TIME_SOURCE_NTP,
+  TIME_SOURCE_SYNTHETIC,  // Test pattern generator: always reported as good
+};
+
+enum TimeQualityLevel : uint8_t {
+  TIME_QUALITY_INVALID,   // RMC V/N, GGA 0, GSA 1
+  TIME_QUALITY_ESTIMATED, // RMC V/E, GGA 6 (dead reckoning), GSA 1
+  TIME_QUALITY_DEGRADED,  // RMC A/A, GGA 1 with few satellites, GSA 2
+  TIME_QUALITY_GOOD,      // RMC A/A, GGA 1, GSA 3
+};
+
+struct TimeQualityInput {
+  TimeSource source;
+  uint32_t syncAgeS;       // Since the last NTP sample
+  uint32_t rttUs;          // Of the last NTP sample
+  uint32_t driftPpb;       // Estimated oscillator drift, 0 = unknown
+};
+
+struct TimeQuality {
+  TimeQualityLevel level;
+  uint32_t errorUs;        // Estimated bound, saturates at UINT32_MAX
+  char rmcStatus;          // 'A' or 'V'
+  char rmcMode;            // NMEA 2.3 mode indicator: 'A', 'E' or 'N'
+  uint8_t ggaQuality;      // 0, 1 or 6
+  uint8_t satellites;
+  uint16_t hdop10;         // HDOP times ten
+  uint8_t gsaMode;         // 1 = no fix, 2 = 2D, 3 = 3D
+};
+
+const uint32_t timeQualityDefaultDriftPpb = 20000;  // 20 ppm
+// Good allows for the half round trip of a typical internet NTP server on
+// top of 10 ms of drift, so a unit is good right after a normal sync
+const uint32_t timeQualityTypicalRttUs = 50000;
+const uint32_t timeQualityGoodUs = 10000 + timeQualityTypicalRttUs / 2;
+const uint32_t timeQualityDegradedUs = 100000;
+const uint32_t timeQualityEstimatedUs = 1000000;
+const char *const timeQualityNames[] = {"invalid", "estimated", "degraded", "good"};
+
+inline uint32_t timeQualityErrorUs(const TimeQualityInput &in) {
+  if (in.source == TIME_SOURCE_SYNTHETIC) return 0;
+  if (in.source != TIME_SOURCE_NTP) return UINT32_MAX;
+  uint32_t drift = in.driftPpb ? in.driftPpb : timeQualityDefaultDriftPpb;
+  uint64_t err = in.rttUs / 2 + (uint64_t)in.syncAgeS * drift / 1000;
+  return err > UINT32_MAX ? UINT32_MAX : (uint32_t)err;
+}
+
+// HDOP grows by 0.1 per millisecond of estimated error, from 0.8 up to 99.0
+inline uint16_t timeQualityHdop10(uint32_t errorUs) {
+  uint32_t h = 8 + errorUs / 1000;
+  return h > 990 ? 990 : (uint16_t)h;
+}
+
+inline TimeQuality timeQualityFrom(const TimeQualityInput &in) {
+  TimeQuality q;
+  q.errorUs = timeQualityErrorUs(in);
+  q.hdop10 = timeQualityHdop10(q.errorUs);
+  if (in.source == TIME_SOURCE_RTC || (in.source == TIME_SOURCE_NTP && q.errorUs > timeQualityDegradedUs &&
+                                       q.errorUs <= timeQualityEstimatedUs)) {
+    q.level = TIME_QUALITY_ESTIMATED;
+    q.rmcStatus = 'V';
+    q.rmcMode = 'E';
+    q.ggaQuality = 6;
+    q.satellites = 0;
+    q.gsaMode = 1;
+  } else if (q.errorUs <= timeQualityGoodUs) {
+    q.level = TIME_QUALITY_GOOD;
+    q.rmcStatus = 'A';
+    q.rmcMode = 'A';
+    q.ggaQuality = 1;
+    q.satellites = 8;
+    q.gsaMode = 3;
+  } else if (q.errorUs <= timeQualityDegradedUs) {
+    q.level = TIME_QUALITY_DEGRADED;
+    q.rmcStatus = 'A';
+    q.rmcMode = 'A';
+    q.ggaQuality = 1;
+    q.satellites = 4;
+    q.gsaMode = 2;
+  } else {
+    q.level = TIME_QUALITY_INVALID;
+    q.rmcStatus = 'V';
+    q.rmcMode = 'N';
+    q.ggaQuality = 0;
+    q.satellites = 0;
+    q.gsaMode = 1;
+  }
+  return q;
+}
+
+// Drift in parts per billion from a correction that accumulated over
+// `intervalS`; 0 when the interval is too short to tell
+inline uint32_t timeQualityDriftPpb(int64_t correctionUs, uint32_t intervalS) {
+  if (intervalS < 60) return 0;
+  uint64_t mag = correctionUs < 0 ? (uint64_t)-correctionUs : (uint64_t)correctionUs;
+  uint64_t ppb = mag * 1000 / intervalS;
+  return ppb > UINT32_MAX ? UINT32_MAX : (uint32_t)ppb;
+}
+
+#endif // TIME_QUALITY_H
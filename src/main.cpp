@@ -4,7 +4,7 @@
  * Description:
  * This code runs on an ESP32 with a TFT display. Its primary function is to
  * connect to a WiFi network, get accurate time from an NTP server, and then
- * emulate a GPS module by outputting NMEA sentences ($GPRMC) over a serial
+ * emulate a GPS module by outputting NMEA sentences ($GPRMC, $GPGGA, $GPGSA) over a serial
  * port. This is ideal for devices like Nixie clocks that require a GPS signal
  * for time synchronization but are used indoors where GPS reception is poor.
  *
@@ -24,11 +24,26 @@
  */
 
 #include <WiFi.h>
+#include <WiFiUdp.h>
 #include <WebServer.h>
 #include <Preferences.h>
 #include <ESPmDNS.h>
+#include <esp_sntp.h>
+#include <esp_wifi.h>
 #include <TFT_eSPI.h>
 #include <sys/time.h>
+#include <driver/uart.h>
+#include <hal/uart_ll.h>
+#include <esp_partition.h>
+#include <mbedtls/md.h>
+#include "FastFormat.h"
+#include "NetworkSelect.h"
+#include "CivilTime.h"
+#include "AssetImage.h"
+#include "InputTrace.h"
+#include "TimeQuality.h"
+#include "DriftModel.h"
+#include "FleetConfig.h"
 
 // Hardware Definitions
 TFT_eSPI tft = TFT_eSPI();
@@ -42,11 +57,16 @@ Preferences preferences;
 
 int screenRotation = 1;  // 1 = normal, 3 = 180 degrees
 
-String ssid = "";
+String ssid = "";      // Network currently in use (one of savedNetworks)
 String password = "";
 String hostname = "NixieGPSEmu";
 String ntpServer = "pool.ntp.org";
 int baudrate = 9600;
+enum NtpPsMode { NTP_PS_AUTO, NTP_PS_SLEEP, NTP_PS_AWAKE, NTP_PS_MODE_COUNT };
+int ntpPowerSave = NTP_PS_AUTO;  // NtpPsMode: radio power save around NTP exchanges
+enum NmeaSet { NMEA_SET_RMC, NMEA_SET_FULL, NMEA_SET_COUNT };
+const char *const nmeaSetNames[NMEA_SET_COUNT] = {"rmc", "full"};
+int nmeaSet = NMEA_SET_RMC;  // Sentences per epoch: RMC alone (default), or RMC + GGA + GSA
 
 bool configMode = false;
 bool timeSet = false;
@@ -55,253 +75,3362 @@ bool buttonPressed = false;
 WebServer server(80);
 
 // Timing variables for non-blocking operations
-unsigned long lastDisplayUpdate = 0;
-const unsigned long displayInterval = 1000;
+unsigned long buttonPressStart = 0;
+
+unsigned long testPatternUntil = 0; // Display test pattern shown until this millis()
+
+// New globals for WiFi retry logic
+unsigned long lastWifiRetry = 0;
+const unsigned long wifiRetryInterval = 15000; // Give up on an attempt and pick a network again
+bool servicesStarted = false; // Flag to track if NTP and mDNS are running
+
+// Concurrent AP+STA configuration mode
+int staChannel = 1;                     // Last channel the station link used (persisted)
+const unsigned long apScanDwellMs = 80; // Per-channel scan dwell while the station link is up
+
+// =================================================================
+// LOOP STALL MONITOR
+// =================================================================
+
+// Each potentially slow piece of loop() runs inside a SubsystemScope. The
+// scopes form a breadcrumb stack (used as a short software backtrace), feed a
+// small ring of trace events and remember which subsystem ran longest in the
+// current iteration. When the gap between loop iterations, or between the
+// expected and actual emission, exceeds its threshold, that subsystem is
+// blamed and a stall report is written to RTC memory, which survives a
+// software reset.
+
+enum Subsystem : uint8_t {
+  SUB_IDLE, SUB_HTTP, SUB_WIFI_SCAN, SUB_DISPLAY, SUB_WIFI, SUB_NVS, SUB_EMIT,
+  SUB_NTP, SUB_LOG, SUB_CLOCK, SUB_FLEET, SUB_BENCH, SUB_CONSOLE, SUB_COUNT
+};
+const char *const subsystemNames[SUB_COUNT] = {
+  "idle", "http", "wifi-scan", "display", "wifi", "nvs", "emit", "ntp", "log", "clock", "fleet", "bench",
+  "console"
+};
+
+enum StallKind : uint8_t { STALL_LOOP, STALL_EMIT };
+enum TraceKind : uint8_t { TRACE_SECTION, TRACE_EMIT, TRACE_STALL };
+
+const uint32_t loopStallThresholdUs = 50000;  // Max gap between loop iterations
+const uint32_t emitLateThresholdUs = 50000;   // Max emission lateness
+const uint32_t traceMinSectionUs = 1000;      // Shorter sections are not traced
+
+struct TraceEvent {
+  uint32_t us;     // micros() at the event
+  uint32_t value;  // Section duration, emission lateness or stall gap (us)
+  uint8_t kind;
+  uint8_t sub;
+};
+
+const int subsystemDepthMax = 4;
+const int traceRingSize = 32;
+const int stallTraceEvents = 12;
+const uint32_t stallReportMagic = 0x5354414C; // "STAL"
+
+struct StallReport {
+  uint32_t magic;
+  uint32_t count;      // Stalls recorded since the last power-on
+  uint32_t uptimeMs;
+  uint32_t gapUs;
+  uint8_t kind;
+  uint8_t cause;
+  uint8_t pathDepth;
+  uint8_t path[subsystemDepthMax];
+  TraceEvent events[stallTraceEvents]; // Oldest first
+};
+
+RTC_NOINIT_ATTR StallReport lastStallReport;
+
+uint32_t loopStalls[SUB_COUNT] = {0};
+uint32_t lateEmissions[SUB_COUNT] = {0};
+
+uint8_t subsystemStack[subsystemDepthMax];
+int subsystemDepth = 0;
+
+TraceEvent traceRing[traceRingSize];
+uint32_t traceCount = 0;
+
+// Longest section of the current and of the previous loop iteration
+uint32_t iterWorstUs = 0;
+uint8_t iterWorstPath[subsystemDepthMax];
+int iterWorstDepth = 0;
+uint32_t prevWorstUs = 0;
+uint8_t prevWorstPath[subsystemDepthMax];
+int prevWorstDepth = 0;
+
+uint32_t lastLoopStartUs = 0;
+uint32_t lastEmissionUs = 0;
+
+void traceEvent(uint8_t kind, uint8_t sub, uint32_t value) {
+  TraceEvent &e = traceRing[traceCount % traceRingSize];
+  e.us = micros();
+  e.value = value;
+  e.kind = kind;
+  e.sub = sub;
+  traceCount++;
+}
+
+class SubsystemScope {
+public:
+  explicit SubsystemScope(Subsystem sub) : startUs(micros()), pushed(subsystemDepth < subsystemDepthMax) {
+    if (pushed) subsystemStack[subsystemDepth] = sub;
+    subsystemDepth++;
+  }
+
+  ~SubsystemScope() {
+    uint32_t durationUs = micros() - startUs;
+    int depth = subsystemDepth < subsystemDepthMax ? subsystemDepth : subsystemDepthMax;
+    if (durationUs >= traceMinSectionUs && pushed) {
+      traceEvent(TRACE_SECTION, subsystemStack[depth - 1], durationUs);
+    }
+    if (durationUs > iterWorstUs) {
+      iterWorstUs = durationUs;
+      iterWorstDepth = depth;
+      memcpy(iterWorstPath, subsystemStack, depth);
+    }
+    subsystemDepth--;
+  }
+
+private:
+  uint32_t startUs;
+  bool pushed;
+};
+
+void recordStall(uint8_t kind, uint32_t gapUs, const uint8_t *path, int depth) {
+  uint8_t cause = depth > 0 ? path[depth - 1] : (uint8_t)SUB_IDLE;
+  if (kind == STALL_LOOP) {
+    loopStalls[cause]++;
+  } else {
+    lateEmissions[cause]++;
+  }
+  traceEvent(TRACE_STALL, cause, gapUs);
+
+  StallReport &r = lastStallReport;
+  r.count = (r.magic == stallReportMagic) ? r.count + 1 : 1;
+  r.magic = stallReportMagic;
+  r.uptimeMs = millis();
+  r.gapUs = gapUs;
+  r.kind = kind;
+  r.cause = cause;
+  r.pathDepth = depth;
+  memcpy(r.path, path, depth);
+  uint32_t first = traceCount > stallTraceEvents ? traceCount - stallTraceEvents : 0;
+  memset(r.events, 0, sizeof(r.events));
+  for (uint32_t i = first; i < traceCount; i++) {
+    r.events[i - first] = traceRing[i % traceRingSize];
+  }
+
+  Serial.printf("Stall: %s overrun %lu us, cause %s\n",
+                kind == STALL_LOOP ? "loop" : "emission", (unsigned long)gapUs,
+                subsystemNames[cause]);
+}
+
+// Called at the top of every loop() iteration
+void stallMonitorLoopStart() {
+  uint32_t now = micros();
+  if (lastLoopStartUs != 0 && now - lastLoopStartUs > loopStallThresholdUs) {
+    recordStall(STALL_LOOP, now - lastLoopStartUs, iterWorstPath, iterWorstDepth);
+  }
+  lastLoopStartUs = now;
+  prevWorstUs = iterWorstUs;
+  prevWorstDepth = iterWorstDepth;
+  memcpy(prevWorstPath, iterWorstPath, iterWorstDepth);
+  iterWorstUs = 0;
+  iterWorstDepth = 0;
+}
+
+// Called for every emitted epoch; expected one second after the previous one
+void stallMonitorEmission() {
+  uint32_t now = micros();
+  if (lastEmissionUs != 0) {
+    int32_t lateUs = (int32_t)(now - lastEmissionUs - 1000000UL);
+    traceEvent(TRACE_EMIT, SUB_EMIT, lateUs > 0 ? lateUs : 0);
+    if (lateUs > (int32_t)emitLateThresholdUs) {
+      if (iterWorstUs > prevWorstUs) {
+        recordStall(STALL_EMIT, lateUs, iterWorstPath, iterWorstDepth);
+      } else {
+        recordStall(STALL_EMIT, lateUs, prevWorstPath, prevWorstDepth);
+      }
+    }
+  }
+  lastEmissionUs = now;
+}
+
+void printStallReport() {
+  const StallReport &r = lastStallReport;
+  if (r.magic != stallReportMagic || r.pathDepth > subsystemDepthMax) {
+    Serial.println("No stall report.");
+    return;
+  }
+  Serial.printf("Last stall (%lu since power-on): %s overrun %lu us at %lu ms\n",
+                (unsigned long)r.count, r.kind == STALL_LOOP ? "loop" : "emission",
+                (unsigned long)r.gapUs, (unsigned long)r.uptimeMs);
+  Serial.print("  Backtrace: ");
+  for (int i = 0; i < r.pathDepth; i++) {
+    Serial.print(i ? " > " : "");
+    Serial.print(subsystemNames[r.path[i] < SUB_COUNT ? r.path[i] : (uint8_t)SUB_IDLE]);
+  }
+  Serial.println();
+  for (int i = 0; i < stallTraceEvents; i++) {
+    const TraceEvent &e = r.events[i];
+    if (e.us == 0 && e.value == 0) continue;
+    const char *kind = e.kind == TRACE_SECTION ? "section" : e.kind == TRACE_EMIT ? "emit" : "stall";
+    Serial.printf("  %10lu us %-7s %-9s %lu us\n", (unsigned long)e.us, kind,
+                  subsystemNames[e.sub < SUB_COUNT ? e.sub : (uint8_t)SUB_IDLE], (unsigned long)e.value);
+  }
+}
+
+// =================================================================
+// INPUT CAPTURE (RECORD / REPLAY)
+// =================================================================
+
+// While capture is on, every external input (WiFi link changes, NTP samples,
+// HTTP requests, button edges, scan results) is appended with its millis()
+// timestamp to a RAM buffer in the format of InputTrace.h. 'capture dump'
+// prints it as hex lines that tools/replay feeds back into the firmware on
+// the host. Inputs that do not fit are counted and dropped.
+
+const size_t captureBufferSize = 16384;
+
+uint8_t *captureBuffer = NULL;
+size_t captureUsed = 0;
+uint32_t captureDropped = 0;
+bool captureActive = false;
+portMUX_TYPE captureMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Safe from any task: WiFi events arrive on the event loop task
+void captureInput(uint8_t type, const void *payload, size_t len) {
+  if (!captureActive) return;
+  if (len > inputPayloadMax) len = inputPayloadMax;
+  uint32_t ms = millis();
+  portENTER_CRITICAL(&captureMux);
+  if (captureUsed + inputRecordHeaderSize + len > captureBufferSize) {
+    captureDropped++;
+  } else {
+    uint8_t *p = captureBuffer + captureUsed;
+    p[0] = type;
+    p[1] = (uint8_t)len;
+    for (int i = 0; i < 4; i++) p[2 + i] = (uint8_t)(ms >> (8 * i));
+    memcpy(p + inputRecordHeaderSize, payload, len);
+    captureUsed += inputRecordHeaderSize + len;
+  }
+  portEXIT_CRITICAL(&captureMux);
+}
+
+void captureStart() {
+  if (captureBuffer == NULL) captureBuffer = (uint8_t *)malloc(captureBufferSize);
+  if (captureBuffer == NULL) {
+    Serial.println("No memory for capture buffer");
+    return;
+  }
+  portENTER_CRITICAL(&captureMux);
+  captureUsed = 0;
+  captureDropped = 0;
+  captureActive = true;
+  portEXIT_CRITICAL(&captureMux);
+}
+
+void captureWifiEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+    uint8_t payload[6];
+    payload[0] = WiFi.channel();
+    payload[1] = (uint8_t)WiFi.RSSI();
+    memcpy(payload + 2, &info.got_ip.ip_info.ip.addr, 4);
+    captureInput(INPUT_WIFI_UP, payload, sizeof(payload));
+  } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+    uint8_t reason = info.wifi_sta_disconnected.reason;
+    captureInput(INPUT_WIFI_DOWN, &reason, 1);
+  }
+}
+
+void captureNtpSample(uint32_t rttUs, int64_t correctionUs) {
+  uint8_t payload[12];
+  for (int i = 0; i < 4; i++) payload[i] = (uint8_t)(rttUs >> (8 * i));
+  for (int i = 0; i < 8; i++) payload[4 + i] = (uint8_t)((uint64_t)correctionUs >> (8 * i));
+  captureInput(INPUT_NTP_SAMPLE, payload, sizeof(payload));
+}
+
+// Called at the top of every route handler
+void captureHttpRequest() {
+  if (!captureActive) return;
+  uint8_t payload[inputPayloadMax];
+  FmtBuf out((char *)payload + 1, sizeof(payload) - 1);
+  payload[0] = server.method() == HTTP_POST ? 2 : 1;
+  fmtStr(out, server.uri().c_str());
+  for (int i = 0; i < server.args(); i++) {
+    String name = server.argName(i);
+    if (name == "password" || name == "plain") continue;
+    fmtChar(out, i == 0 ? '?' : '&');
+    fmtStr(out, name.c_str());
+    fmtChar(out, '=');
+    fmtStr(out, server.arg(i).c_str());
+  }
+  captureInput(INPUT_HTTP, payload, 1 + out.length());
+}
+
+// A received fleet push, split over as many records as it needs. received
+// is the datagram's length, len what was read of it.
+void captureFleetPacket(const uint8_t *packet, size_t len, size_t received, IPAddress ip, uint16_t port) {
+  if (!captureActive) return;
+  uint8_t payload[inputPayloadMax];
+  const size_t chunkMax = inputPayloadMax - inputFleetHeaderSize;
+  for (int i = 0; i < 4; i++) payload[1 + i] = ip[i];
+  payload[5] = (uint8_t)port;
+  payload[6] = (uint8_t)(port >> 8);
+  payload[7] = (uint8_t)received;
+  payload[8] = (uint8_t)(received >> 8);
+  size_t off = 0;
+  do {
+    size_t n = len - off < chunkMax ? len - off : chunkMax;
+    payload[0] = off + n < len ? 1 : 0;
+    memcpy(payload + inputFleetHeaderSize, packet + off, n);
+    captureInput(INPUT_FLEET, payload, inputFleetHeaderSize + n);
+    off += n;
+  } while (off < len);
+}
+
+void captureButton(bool pressed) {
+  uint8_t level = pressed ? 0 : 1;
+  captureInput(INPUT_BUTTON, &level, 1);
+}
+
+// Printed from the console task; capture must be stopped first
+void captureDump() {
+  Serial.printf("TRACE BEGIN %u bytes, %lu dropped\n", (unsigned)captureUsed, (unsigned long)captureDropped);
+  char line[8 + 2 * 32];
+  for (size_t off = 0; off < captureUsed; off += 32) {
+    FmtBuf out(line, sizeof(line));
+    fmtStr(out, "TRACE ");
+    for (size_t i = off; i < captureUsed && i < off + 32; i++) fmtHex2(out, captureBuffer[i]);
+    Serial.println(line);
+  }
+  Serial.println("TRACE END");
+}
+
+// =================================================================
+// TIME & STATUS FUNCTIONS
+// =================================================================
+
+void updateTimeStatus() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  struct tm *tm_struct = gmtime(&tv.tv_sec);
+  // Consider time "set" if the year is plausible (post-2020)
+  timeSet = (tm_struct->tm_year + 1900) >= 2020;
+}
+
+// =================================================================
+// CONFIGURATION MANAGEMENT (SAVE/LOAD FROM FLASH)
+// =================================================================
+
+// Saved networks, most recently configured first. Slot 0 keeps the original
+// "ssid"/"password" keys; the others use "ssid1"/"pass1" and so on. Their
+// connection history is stored as one blob.
+const int maxNetworks = 4;
+
+struct SavedNetwork {
+  String ssid;
+  String password;
+  NetworkStats stats;
+};
+
+SavedNetwork savedNetworks[maxNetworks];
+int savedNetworkCount = 0;
+int currentNetwork = 0;
+bool networkStatsSavePending = false;
+
+const char *networkKey(char *buf, size_t size, const char *base, int slot) {
+  FmtBuf key(buf, size);
+  fmtStr(key, base);
+  if (slot > 0) fmtUint(key, slot);
+  return buf;
+}
+
+// Learned by the holdover code (DriftModel.h), kept across restarts
+DriftModel driftModel = {};
+bool driftModelSavePending = false;
+
+void loadDriftModel() {
+  if (preferences.getBytesLength("driftmodel") == sizeof(driftModel)) {
+    preferences.getBytes("driftmodel", &driftModel, sizeof(driftModel));
+  }
+}
+
+void saveDriftModel() {
+  preferences.putBytes("driftmodel", &driftModel, sizeof(driftModel));
+}
+
+// Fleet pushes (FleetConfig.h): the key shared by the fleet and the version
+// of the last delta applied. The version is saved with the other settings.
+uint8_t fleetKey[fleetKeySize];
+bool fleetKeySet = false;
+bool fleetKeySavePending = false;
+uint32_t fleetVersion = 0;
+
+void saveFleetKey() {
+  if (fleetKeySet) {
+    preferences.putBytes("fleetkey", fleetKey, sizeof(fleetKey));
+  } else if (preferences.isKey("fleetkey")) {
+    preferences.remove("fleetkey");
+  }
+}
+
+void saveNetworkStats() {
+  NetworkStats stats[maxNetworks] = {};
+  for (int i = 0; i < savedNetworkCount; i++) stats[i] = savedNetworks[i].stats;
+  preferences.putBytes("netstats", stats, sizeof(stats));
+}
+
+void saveConfig() {
+  SubsystemScope scope(SUB_NVS);
+  char key[12];
+  for (int i = 0; i < maxNetworks; i++) {
+    const char *ssidKey = networkKey(key, sizeof(key), "ssid", i);
+    if (i < savedNetworkCount) {
+      preferences.putString(ssidKey, savedNetworks[i].ssid);
+    } else if (preferences.isKey(ssidKey)) {
+      preferences.remove(ssidKey);
+    }
+    const char *passKey = networkKey(key, sizeof(key), i == 0 ? "password" : "pass", i);
+    if (i < savedNetworkCount) {
+      preferences.putString(passKey, savedNetworks[i].password);
+    } else if (preferences.isKey(passKey)) {
+      preferences.remove(passKey);
+    }
+  }
+  saveNetworkStats();
+  networkStatsSavePending = false;
+  preferences.putString("hostname", hostname);
+  preferences.putString("ntpserver", ntpServer);
+  preferences.putInt("baudrate", baudrate);
+  preferences.putInt("rotation", screenRotation);
+  preferences.putInt("ntpps", ntpPowerSave);
+  preferences.putInt("nmeaset", nmeaSet);
+  preferences.putInt("fleetver", (int32_t)fleetVersion);
+}
+
+// Writes outside the /save handler are deferred to the planner's NVS slot
+bool configSavePending = false;
+bool staChannelSavePending = false;
+
+void requestConfigSave() {
+  configSavePending = true;
+}
+
+void saveStaChannel(int channel) {
+  if (channel < 1 || channel > 13 || channel == staChannel) return;
+  staChannel = channel;
+  staChannelSavePending = true;
+}
+
+// Puts a network in slot 0, keeping its history if it is already known.
+// An empty password keeps the stored one.
+void addNetwork(const char *newSsid, const char *newPassword) {
+  int idx = 0;
+  while (idx < savedNetworkCount && savedNetworks[idx].ssid != newSsid) idx++;
+  SavedNetwork net;
+  if (idx < savedNetworkCount) {
+    net = savedNetworks[idx];
+  } else {
+    net.ssid = newSsid;
+    net.stats = NetworkStats();
+    if (savedNetworkCount < maxNetworks) savedNetworkCount++;
+    idx = savedNetworkCount - 1; // Oldest entry is dropped when full
+  }
+  if (newPassword[0] != '\0') net.password = newPassword;
+  for (int i = idx; i > 0; i--) savedNetworks[i] = savedNetworks[i - 1];
+  savedNetworks[0] = net;
+  currentNetwork = 0;
+  ssid = net.ssid;
+  password = net.password;
+}
+
+// Returns true if it was the network in use. The ssid/password globals then
+// point at another saved network, or are cleared when none is left.
+bool forgetNetwork(int idx) {
+  if (idx < 0 || idx >= savedNetworkCount) return false;
+  bool wasCurrent = idx == currentNetwork;
+  for (int i = idx; i < savedNetworkCount - 1; i++) savedNetworks[i] = savedNetworks[i + 1];
+  savedNetworkCount--;
+  savedNetworks[savedNetworkCount] = SavedNetwork();
+  if (idx < currentNetwork) currentNetwork--;
+  if (currentNetwork >= savedNetworkCount) currentNetwork = 0;
+  if (wasCurrent) {
+    ssid = savedNetworkCount > 0 ? savedNetworks[currentNetwork].ssid : "";
+    password = savedNetworkCount > 0 ? savedNetworks[currentNetwork].password : "";
+  }
+  return wasCurrent;
+}
+
+void flushPendingConfig() {
+  if (configSavePending) {
+    configSavePending = false;
+    saveConfig();
+  }
+  if (networkStatsSavePending) {
+    SubsystemScope scope(SUB_NVS);
+    networkStatsSavePending = false;
+    saveNetworkStats();
+  }
+  if (staChannelSavePending) {
+    SubsystemScope scope(SUB_NVS);
+    staChannelSavePending = false;
+    preferences.putInt("stachannel", staChannel);
+  }
+  if (driftModelSavePending) {
+    SubsystemScope scope(SUB_NVS);
+    driftModelSavePending = false;
+    saveDriftModel();
+  }
+  if (fleetKeySavePending) {
+    SubsystemScope scope(SUB_NVS);
+    fleetKeySavePending = false;
+    saveFleetKey();
+  }
+}
+
+void loadConfig() {
+  char key[12];
+  savedNetworkCount = 0;
+  for (int i = 0; i < maxNetworks; i++) {
+    String s = preferences.getString(networkKey(key, sizeof(key), "ssid", i), "");
+    if (s == "") continue;
+    SavedNetwork &net = savedNetworks[savedNetworkCount++];
+    net.ssid = s;
+    net.password = preferences.getString(networkKey(key, sizeof(key), i == 0 ? "password" : "pass", i), "");
+    net.stats = NetworkStats();
+  }
+  NetworkStats stats[maxNetworks];
+  if (preferences.getBytesLength("netstats") == sizeof(stats)) {
+    preferences.getBytes("netstats", stats, sizeof(stats));
+    for (int i = 0; i < savedNetworkCount; i++) savedNetworks[i].stats = stats[i];
+  }
+  currentNetwork = 0;
+  ssid = savedNetworkCount > 0 ? savedNetworks[0].ssid : "";
+  password = savedNetworkCount > 0 ? savedNetworks[0].password : "";
+  hostname = preferences.getString("hostname", "NixieGPSEmu");
+  ntpServer = preferences.getString("ntpserver", "pool.ntp.org");
+  baudrate = preferences.getInt("baudrate", 9600);
+  screenRotation = preferences.getInt("rotation", 1);
+  staChannel = preferences.getInt("stachannel", 1);
+  ntpPowerSave = preferences.getInt("ntpps", NTP_PS_AUTO);
+  if (ntpPowerSave < 0 || ntpPowerSave >= NTP_PS_MODE_COUNT) ntpPowerSave = NTP_PS_AUTO;
+  nmeaSet = preferences.getInt("nmeaset", NMEA_SET_RMC);
+  if (nmeaSet < 0 || nmeaSet >= NMEA_SET_COUNT) nmeaSet = NMEA_SET_RMC;
+  fleetVersion = (uint32_t)preferences.getInt("fleetver", 0);
+  fleetKeySet = preferences.getBytesLength("fleetkey") == sizeof(fleetKey) &&
+                preferences.getBytes("fleetkey", fleetKey, sizeof(fleetKey)) == sizeof(fleetKey);
+}
+
+// =================================================================
+// WIFI SCAN CACHE
+// =================================================================
+
+// Scans run asynchronously from the planner and the results are copied here,
+// so the portal never blocks on WiFi.scanNetworks().
+const int scanCacheMax = 16;
+const unsigned long scanCacheMaxAgeMs = 60000;
+
+struct ScanEntry {
+  char ssid[33];
+  int8_t rssi;
+  uint8_t channel;
+};
+
+ScanEntry scanCache[scanCacheMax];
+int scanCacheCount = 0;
+unsigned long scanCacheTime = 0;
+bool scanCacheValid = false;
+bool scanRequested = false;
+
+bool scanWanted() {
+  return scanRequested || configMode || WiFi.status() != WL_CONNECTED;
+}
+
+// Planner job: harvests a finished scan or starts a new one when stale
+void serviceWifiScan() {
+  int n = WiFi.scanComplete();
+  if (n >= 0) {
+    scanCacheCount = 0;
+    for (int i = 0; i < n && scanCacheCount < scanCacheMax; i++) {
+      ScanEntry &e = scanCache[scanCacheCount++];
+      strlcpy(e.ssid, WiFi.SSID(i).c_str(), sizeof(e.ssid));
+      e.rssi = WiFi.RSSI(i);
+      e.channel = WiFi.channel(i);
+    }
+    WiFi.scanDelete();
+    if (captureActive) {
+      uint8_t payload[inputPayloadMax];
+      size_t len = 1;
+      payload[0] = 0;
+      for (int i = 0; i < scanCacheCount; i++) {
+        size_t ssidLen = strlen(scanCache[i].ssid);
+        if (len + 3 + ssidLen > sizeof(payload)) break;
+        payload[len++] = (uint8_t)scanCache[i].rssi;
+        payload[len++] = scanCache[i].channel;
+        payload[len++] = (uint8_t)ssidLen;
+        memcpy(payload + len, scanCache[i].ssid, ssidLen);
+        len += ssidLen;
+        payload[0]++;
+      }
+      captureInput(INPUT_SCAN, payload, len);
+    }
+    scanCacheTime = millis();
+    scanCacheValid = true;
+    scanRequested = false;
+  } else if (n == WIFI_SCAN_FAILED) {
+    bool stale = !scanCacheValid || millis() - scanCacheTime > scanCacheMaxAgeMs;
+    if (stale && scanWanted()) {
+      // In AP+STA mode every off-channel dwell is time the station link (and
+      // SNTP) is deaf, so keep the active scan short.
+      if (configMode && ssid != "") {
+        WiFi.scanNetworks(true, false, false, apScanDwellMs);
+      } else {
+        WiFi.scanNetworks(true);
+      }
+    }
+  }
+}
+
+// =================================================================
+// REQUEST ARENA (PER-REQUEST BUMP ALLOCATOR)
+// =================================================================
+
+// Every request-scoped buffer (form arguments, HTML fragments, JSON) is carved
+// out of this static block and released in one go once the response has been
+// sent, so web traffic never leaves long-lived holes in the heap.
+const size_t requestArenaSize = 8192;
+alignas(4) char requestArena[requestArenaSize];
+size_t requestArenaUsed = 0;
+bool requestArenaOverflow = false;
+
+enum WebRoute { ROUTE_ROOT, ROUTE_SAVE, ROUTE_STALLS, ROUTE_CONFIG, ROUTE_COUNT };
+const char *const webRouteNames[ROUTE_COUNT] = {"/", "/save", "/stalls", "/config.json"};
+size_t arenaPeak[ROUTE_COUNT] = {0}; // Peak usage per route, for sizing the arena
+
+char *arenaAlloc(size_t size) {
+  size = (size + 3) & ~(size_t)3;
+  if (requestArenaUsed + size > requestArenaSize) {
+    requestArenaOverflow = true;
+    return nullptr;
+  }
+  char *p = requestArena + requestArenaUsed;
+  requestArenaUsed += size;
+  return p;
+}
+
+// Copies a request argument into the arena. Returns "" if it is missing or
+// does not fit. The String returned by server.arg() is freed immediately, so
+// it never outlives the call.
+const char *arenaArg(const char *name) {
+  if (!server.hasArg(name)) return "";
+  String value = server.arg(name);
+  char *p = arenaAlloc(value.length() + 1);
+  if (p == nullptr) return "";
+  memcpy(p, value.c_str(), value.length() + 1);
+  return p;
+}
+
+// Appends a response body to the top of the arena. While a writer is open it
+// owns the free space, so take all arenaArg()/arenaAlloc() copies first.
+struct ArenaWriter {
+  char *start = nullptr;
+  size_t len = 0;
+
+  void begin() {
+    start = requestArena + requestArenaUsed;
+    len = 0;
+    if (requestArenaUsed < requestArenaSize) start[0] = '\0';
+  }
+
+  void add(const char *s, size_t n) {
+    if (requestArenaUsed + n + 1 > requestArenaSize) {
+      requestArenaOverflow = true;
+      return;
+    }
+    memcpy(start + len, s, n);
+    len += n;
+    requestArenaUsed += n;
+    start[len] = '\0';
+  }
+
+  void add(const char *s) { add(s, strlen(s)); }
+  void add(const String &s) { add(s.c_str(), s.length()); }
+
+  void add(long value) {
+    char num[12];
+    FmtBuf b(num, sizeof(num));
+    fmtInt(b, value);
+    add(num, b.length());
+  }
+
+  // Quoted and escaped JSON string
+  void addJson(const char *s) {
+    add("\"", 1);
+    for (; *s != '\0'; s++) {
+      if (*s == '"' || *s == '\\') {
+        char esc[2] = {'\\', *s};
+        add(esc, 2);
+      } else if ((uint8_t)*s < 0x20) {
+        char esc[7];
+        FmtBuf b(esc, sizeof(esc));
+        fmtStr(b, "\\u00");
+        fmtHex2(b, (uint8_t)*s);
+        add(esc, b.length());
+      } else {
+        add(s, 1);
+      }
+    }
+    add("\"", 1);
+  }
+};
+
+void arenaReset() {
+  requestArenaUsed = 0;
+  requestArenaOverflow = false;
+}
+
+// Sends the writer's contents straight out of the arena (no String copy),
+// records the route's peak usage and releases everything in one step.
+void arenaSend(WebRoute route, ArenaWriter &w, const char *contentType) {
+  if (requestArenaUsed > arenaPeak[route]) {
+    arenaPeak[route] = requestArenaUsed;
+  }
+  if (requestArenaOverflow) {
+    Serial.printf("Arena overflow on %s\n", webRouteNames[route]);
+    server.send(500, "text/plain", "Response too large");
+  } else {
+    server.send_P(200, contentType, w.start, w.len);
+  }
+  arenaReset();
+}
+
+// =================================================================
+// WEB ASSETS (FLASH PARTITION)
+// =================================================================
+
+// Static portal files live in their own "assets" partition, built by
+// tools/build_assets.py and flashed independently of the firmware. The image
+// is memory-mapped once at boot and files are sent straight from the mapped
+// flash, pre-compressed, without being copied into RAM. Without a valid
+// image the built-in pages below are served instead.
+
+const AssetImageHeader *assetHeader = NULL;
+const AssetEntry *assetEntries = NULL;
+spi_flash_mmap_handle_t assetMapHandle;
+
+bool assetEntryValid(const AssetEntry &e, uint32_t imageSize) {
+  return memchr(e.path, '\0', assetPathMax) != NULL && e.path[0] == '/' &&
+         memchr(e.mime, '\0', assetMimeMax) != NULL &&
+         e.offset <= imageSize && e.length <= imageSize - e.offset;
+}
+
+void mountAssets() {
+  const esp_partition_t *part = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)assetPartitionSubtype, "assets");
+  if (part == NULL) {
+    Serial.println("No asset partition, using built-in pages");
+    return;
+  }
+  AssetImageHeader hdr;
+  if (esp_partition_read(part, 0, &hdr, sizeof(hdr)) != ESP_OK || hdr.magic != assetImageMagic ||
+      hdr.version != assetImageVersion || hdr.imageSize > part->size ||
+      hdr.imageSize < sizeof(hdr) + hdr.count * sizeof(AssetEntry)) {
+    Serial.println("No valid asset image, using built-in pages");
+    return;
+  }
+  const void *base;
+  if (esp_partition_mmap(part, 0, hdr.imageSize, SPI_FLASH_MMAP_DATA, &base, &assetMapHandle) != ESP_OK) {
+    Serial.println("Error mapping asset partition");
+    return;
+  }
+  const AssetEntry *entries = (const AssetEntry *)((const uint8_t *)base + sizeof(AssetImageHeader));
+  for (int i = 0; i < hdr.count; i++) {
+    if (!assetEntryValid(entries[i], hdr.imageSize)) {
+      Serial.println("Corrupt asset image, using built-in pages");
+      spi_flash_munmap(assetMapHandle);
+      return;
+    }
+  }
+  assetHeader = (const AssetImageHeader *)base;
+  assetEntries = entries;
+  Serial.printf("Mounted %u web assets (%lu bytes)\n", (unsigned)hdr.count, (unsigned long)hdr.imageSize);
+}
+
+const AssetEntry *findAsset(const char *path) {
+  if (assetHeader == NULL) return NULL;
+  for (int i = 0; i < assetHeader->count; i++) {
+    if (strcmp(assetEntries[i].path, path) == 0) return &assetEntries[i];
+  }
+  return NULL;
+}
+
+void serveAsset(const AssetEntry *e) {
+  if (e->flags & assetFlagGzip) server.sendHeader("Content-Encoding", "gzip");
+  server.sendHeader("Cache-Control", "max-age=3600");
+  server.send_P(200, e->mime, (const char *)assetHeader + e->offset, e->length);
+}
+
+void registerAssetRoutes() {
+  if (assetHeader == NULL) return;
+  for (int i = 0; i < assetHeader->count; i++) {
+    const AssetEntry *e = &assetEntries[i];
+    server.on(e->path, HTTP_GET, [e]() {
+      captureHttpRequest();
+      serveAsset(e);
+    });
+  }
+}
+
+// =================================================================
+// WEB SERVER & CONFIGURATION PORTAL
+// =================================================================
+
+// Also rendered by the emission benchmark as its stand-in for web traffic
+void renderConfigJson(ArenaWriter &json) {
+  json.add("{\"ssid\":");
+  json.addJson(ssid.c_str());
+  json.add(",\"hostname\":");
+  json.addJson(hostname.c_str());
+  json.add(",\"ntpserver\":");
+  json.addJson(ntpServer.c_str());
+  json.add(",\"baudrate\":");
+  json.add((long)baudrate);
+  json.add(",\"rotation\":");
+  json.add((long)screenRotation);
+  json.add(",\"nmea\":");
+  json.addJson(nmeaSetNames[nmeaSet]);
+  json.add(",\"fleetversion\":");
+  json.add((long)fleetVersion);
+  json.add(",\"scanning\":");
+  json.add(scanCacheValid ? "false" : "true");
+  json.add(",\"networks\":[");
+  for (int i = 0; i < scanCacheCount; i++) {
+    if (i) json.add(",");
+    json.add("{\"ssid\":");
+    json.addJson(scanCache[i].ssid);
+    json.add(",\"rssi\":");
+    json.add((long)scanCache[i].rssi);
+    json.add("}");
+  }
+  json.add("]}");
+}
+
+void setupWebRoutes() {
+  server.on("/", []() {
+    captureHttpRequest();
+    const AssetEntry *index = findAsset("/index.html");
+    if (index != NULL) {
+      serveAsset(index); // Filled in by portal.js from /config.json
+      return;
+    }
+    ArenaWriter html;
+    html.begin();
+    html.add("<html><head><title>NixieGPS-Emulator</title>"
+             "<style>"
+             "body { font-family: Arial, sans-serif; background-color: #222; color: #eee; font-size: 24px; }"
+             "form { margin: auto; width: 640px; padding: 40px; background: #333; border-radius: 20px; }"
+             "input, select { width: 100%; margin: 16px 0; padding: 16px; border-radius: 8px; border: none; font-size: 24px; box-sizing: border-box; }"
+             "input[type=submit] { background-color: #4CAF50; color: white; font-weight: bold; cursor: pointer; padding: 16px; }"
+             "h2 { text-align: center; font-size: 28px; }"
+             "</style>"
+             "</head><body><form method='POST' action='/save'>"
+             "<h2>NixieGPS-Emulator Configure WiFi and Settings</h2>");
+    html.add("SSID: <select name='ssid'>");
+    if (!scanCacheValid) {
+      // First visit: offer the saved network and let the planner scan
+      scanRequested = true;
+      if (ssid != "") {
+        html.add("<option value='");
+        html.add(ssid);
+        html.add("' selected>");
+        html.add(ssid);
+        html.add("</option>");
+      }
+      html.add("<option value='' disabled>Scanning, reload to refresh</option>");
+    }
+    for (int i = 0; i < scanCacheCount; ++i) {
+      const ScanEntry &e = scanCache[i];
+      html.add("<option value='");
+      html.add(e.ssid);
+      html.add("'");
+      // Improvement: Pre-select the currently saved SSID
+      if (ssid == e.ssid) {
+        html.add(" selected");
+      }
+      html.add(">");
+      html.add(e.ssid);
+      html.add(" (");
+      html.add((long)e.rssi);
+      html.add("dBm)</option>");
+    }
+    html.add("</select><br>");
+    html.add("Password: <input type='password' name='password' placeholder='Enter new password'><br>");
+    html.add("Hostname: <input type='text' name='hostname' value='");
+    html.add(hostname);
+    html.add("'><br>");
+    html.add("NTP Server: <input type='text' name='ntpserver' value='");
+    html.add(ntpServer);
+    html.add("'><br>");
+    html.add("Baudrate: <input type='number' name='baudrate' value='");
+    html.add((long)baudrate);
+    html.add("'><br>");
+    html.add("Screen Rotation: <select name='rotation'>");
+    html.add("<option value='1'");
+    if (screenRotation == 1) html.add(" selected");
+    html.add(">Normal</option>");
+
+    html.add("<option value='3'");
+    if (screenRotation == 3) html.add(" selected");
+    html.add(">180 Degrees</option>");
+    html.add("</select><br>");
+    html.add("NMEA Sentences: <select name='nmea'>");
+    html.add("<option value='rmc'");
+    if (nmeaSet == NMEA_SET_RMC) html.add(" selected");
+    html.add(">RMC only</option>");
+    html.add("<option value='full'");
+    if (nmeaSet == NMEA_SET_FULL) html.add(" selected");
+    html.add(">RMC + GGA + GSA</option>");
+    html.add("</select><br>");
+    html.add("<input type='submit' value='Save'>");
+    html.add("</form></body></html>");
+    arenaSend(ROUTE_ROOT, html, "text/html");
+  });
+
+  server.on("/save", []() {
+    captureHttpRequest();
+    const char *argSsid = arenaArg("ssid");
+    const char *argPassword = arenaArg("password");
+    const char *argHostname = arenaArg("hostname");
+    const char *argNtpServer = arenaArg("ntpserver");
+    const char *argBaudrate = arenaArg("baudrate");
+    const char *argRotation = arenaArg("rotation");
+    const char *argNmea = arenaArg("nmea");
+
+    if (argSsid[0] != '\0') {
+      addNetwork(argSsid, argPassword);
+    } else if (argPassword[0] != '\0' && savedNetworkCount > 0) {
+      // Only update password if a new one is provided
+      savedNetworks[currentNetwork].password = argPassword;
+    }
+    if (server.hasArg("hostname")) hostname = argHostname;
+    if (server.hasArg("ntpserver")) ntpServer = argNtpServer;
+    if (server.hasArg("baudrate")) baudrate = atoi(argBaudrate);
+    if (server.hasArg("rotation")) {
+      screenRotation = atoi(argRotation);
+      }
+    for (int i = 0; i < NMEA_SET_COUNT; i++) {
+      if (strcmp(argNmea, nmeaSetNames[i]) == 0) nmeaSet = i;
+    }
+    saveConfig();
+
+    // Improvement: More informative save page
+    ArenaWriter response;
+    response.begin();
+    response.add("<html><head><style>body{font-family: Arial, sans-serif; background-color: #222; color: #eee; font-size: 24px; text-align: center; padding-top: 50px;}</style></head>"
+                 "<body><h2>Settings Saved!</h2>"
+                 "<p>Rebooting and attempting to connect to:</p>"
+                 "<p style='color: #4CAF50; font-weight: bold;'>");
+    response.add(ssid);
+    response.add("</p>"
+                 "</body></html>");
+    arenaSend(ROUTE_SAVE, response, "text/html");
+
+    delay(3000); // Give browser time to render the page
+    ESP.restart();
+  });
+
+  server.on("/config.json", []() {
+    captureHttpRequest();
+    if (!scanCacheValid) scanRequested = true;
+    ArenaWriter json;
+    json.begin();
+    renderConfigJson(json);
+    arenaSend(ROUTE_CONFIG, json, "application/json");
+  });
+
+  registerAssetRoutes();
+
+  server.on("/stalls", []() {
+    captureHttpRequest();
+    ArenaWriter json;
+    json.begin();
+    json.add("{\"loop\":{");
+    for (int i = 0; i < SUB_COUNT; i++) {
+      if (i) json.add(",");
+      json.add("\"");
+      json.add(subsystemNames[i]);
+      json.add("\":");
+      json.add((long)loopStalls[i]);
+    }
+    json.add("},\"emit\":{");
+    for (int i = 0; i < SUB_COUNT; i++) {
+      if (i) json.add(",");
+      json.add("\"");
+      json.add(subsystemNames[i]);
+      json.add("\":");
+      json.add((long)lateEmissions[i]);
+    }
+    json.add("}");
+    const StallReport &r = lastStallReport;
+    if (r.magic == stallReportMagic && r.pathDepth <= subsystemDepthMax) {
+      json.add(",\"last\":{\"kind\":\"");
+      json.add(r.kind == STALL_LOOP ? "loop" : "emission");
+      json.add("\",\"gap_us\":");
+      json.add((long)r.gapUs);
+      json.add(",\"uptime_ms\":");
+      json.add((long)r.uptimeMs);
+      json.add(",\"backtrace\":\"");
+      for (int i = 0; i < r.pathDepth; i++) {
+        if (i) json.add(">");
+        json.add(subsystemNames[r.path[i] < SUB_COUNT ? r.path[i] : (uint8_t)SUB_IDLE]);
+      }
+      json.add("\"}");
+    }
+    json.add("}");
+    arenaSend(ROUTE_STALLS, json, "application/json");
+  });
+}
+
+// =================================================================
+// TEMPERATURE-COMPENSATED HOLDOVER
+// =================================================================
+
+// Between syncs, and through WiFi outages, the system clock is slewed with
+// adjtime() by the correction DriftModel.h predicts for the current chip
+// temperature. Every NTP sample trains the model with the residual error of
+// the interval before it. When the link drops the time is held over rather
+// than declared invalid; its growing uncertainty reaches the NMEA fields
+// through the time-quality estimate.
+
+const float chipTempSmoothing = 0.125f;  // The internal sensor is noisy
+
+DriftInterval driftInterval = {};
+float chipTempC = 0;
+bool chipTempValid = false;
+int32_t clockCorrectionPpb = 0;   // Being applied now
+bool clockModelValid = false;
+int64_t slewCarryNs = 0;          // Not yet handed to adjtime()
+unsigned long lastClockServiceMs = 0;
+int32_t lastResidualPpb = 0;
+
+bool holdoverActive = false;      // From link loss until the next NTP sample
+unsigned long holdoverStartMs = 0;
+uint32_t lastHoldoverS = 0;
+int64_t lastHoldoverErrorUs = 0;
+
+void updateNmeaQuality();
+
+// Planner job, once a second; also renders the NMEA quality fields
+void serviceClock() {
+  float t = temperatureRead();
+  if (!chipTempValid) {
+    chipTempC = t;
+    chipTempValid = true;
+  } else {
+    chipTempC += (t - chipTempC) * chipTempSmoothing;
+  }
+  clockModelValid = driftModelLookup(driftModel, chipTempC, clockCorrectionPpb);
+  if (!clockModelValid) clockCorrectionPpb = 0;
+  updateNmeaQuality();
+
+  unsigned long now = millis();
+  uint32_t elapsedMs = lastClockServiceMs == 0 ? 0 : now - lastClockServiceMs;
+  lastClockServiceMs = now;
+  if (!timeSet || elapsedMs == 0) return;
+
+  int64_t ns = (int64_t)clockCorrectionPpb * elapsedMs / 1000;
+  driftIntervalAdd(driftInterval, chipTempC, elapsedMs, ns);
+  slewCarryNs += ns;
+  int64_t us = slewCarryNs / 1000;
+  if (us == 0) return;
+  slewCarryNs -= us * 1000;
+  // A new adjtime() replaces the old one, so carry over what is left of it
+  struct timeval left;
+  adjtime(NULL, &left);
+  us += (int64_t)left.tv_sec * 1000000 + left.tv_usec;
+  struct timeval delta;
+  delta.tv_sec = (time_t)(us / 1000000);
+  delta.tv_usec = (suseconds_t)(us % 1000000);
+  adjtime(&delta, NULL);
+}
+
+// Per-sample bound on the drift rate for the time-quality estimate; 0 while
+// the model has nothing for this temperature
+uint32_t clockModelUncertaintyPpb() {
+  int32_t ppb;
+  uint32_t uncertainty = 0;
+  if (!chipTempValid || !driftModelLookup(driftModel, chipTempC, ppb, &uncertainty)) return 0;
+  return uncertainty;
+}
+
+// Called for every NTP sample with the correction SNTP just applied. Steps
+// (first sync, or after a long outage without a model) are not residuals of
+// the slew and only restart the interval.
+void clockLearn(int64_t correctionUs, bool slew) {
+  if (holdoverActive) {
+    holdoverActive = false;
+    lastHoldoverS = (millis() - holdoverStartMs) / 1000;
+    lastHoldoverErrorUs = correctionUs;
+    Serial.printf("Holdover of %lu s ended, clock was off by %lld us\n", (unsigned long)lastHoldoverS,
+                  (long long)correctionUs);
+  }
+  if (slew && driftIntervalMs(driftInterval) >= 60000) {
+    lastResidualPpb = driftModelLearn(driftModel, driftInterval, correctionUs);
+    driftModelSavePending = true;
+  }
+  driftIntervalReset(driftInterval);
+  slewCarryNs = 0;
+}
+
+void startHoldover() {
+  holdoverActive = true;
+  holdoverStartMs = millis();
+  Serial.printf("Holding time over, %s\n", clockModelValid ? "temperature-compensated" : "no drift model yet");
+}
+
+void printClockStats() {
+  if (chipTempValid) {
+    Serial.printf("Chip temperature %.1f C, correction %ld ppb (%s)\n", chipTempC,
+                  (long)clockCorrectionPpb, clockModelValid ? "model" : "no model");
+  }
+  Serial.printf("Interval: %lu s, %lld us slewed, last residual %ld ppb\n",
+                (unsigned long)(driftIntervalMs(driftInterval) / 1000),
+                (long long)(driftInterval.appliedNs / 1000), (long)lastResidualPpb);
+  if (holdoverActive) {
+    Serial.printf("Holdover: active for %lu s\n", (millis() - holdoverStartMs) / 1000);
+  } else if (lastHoldoverS > 0) {
+    Serial.printf("Holdover: last %lu s, off by %lld us at the end\n", (unsigned long)lastHoldoverS,
+                  (long long)lastHoldoverErrorUs);
+  }
+  for (int b = 0; b < driftBinCount; b++) {
+    const DriftBin &bin = driftModel.bins[b];
+    if (!driftBinLearned(bin)) continue;
+    Serial.printf("  %4.0f-%-4.0f C  %7ld ppb  +/-%5u  n=%u\n", driftBinCenterC(b) - driftBinWidthC / 2,
+                  driftBinCenterC(b) + driftBinWidthC / 2, (long)bin.ppb, bin.madPpb, bin.samples);
+  }
+}
+
+// =================================================================
+// WIFI MANAGEMENT
+// =================================================================
+
+// Only networks seen in a reasonably recent scan count as visible; without
+// a scan every saved network is a candidate.
+const unsigned long scanVisibilityMs = 120000;
+unsigned long connectAttemptStart = 0;
+bool connectAttemptActive = false;
+
+int8_t networkRssi(const String &name) {
+  if (!scanCacheValid || millis() - scanCacheTime > scanVisibilityMs) return 0;
+  for (int i = 0; i < scanCacheCount; i++) {
+    if (name == scanCache[i].ssid) return scanCache[i].rssi;
+  }
+  return networkNotVisible;
+}
+
+void connectToNetwork(int idx) {
+  currentNetwork = idx;
+  ssid = savedNetworks[idx].ssid;
+  password = savedNetworks[idx].password;
+  networkRecordAttempt(savedNetworks[idx].stats);
+  connectAttemptStart = millis();
+  connectAttemptActive = true;
+  WiFi.begin(ssid.c_str(), password.c_str());
+  Serial.printf("Attempting to connect to saved WiFi: %s\n", ssid.c_str());
+}
+
+// Picks the saved network with the best history among those in range
+void connectToBestNetwork() {
+  if (savedNetworkCount == 0) return;
+  NetworkStats stats[maxNetworks];
+  int8_t rssi[maxNetworks];
+  for (int i = 0; i < savedNetworkCount; i++) {
+    stats[i] = savedNetworks[i].stats;
+    rssi[i] = networkRssi(savedNetworks[i].ssid);
+  }
+  int idx = networkSelect(stats, rssi, savedNetworkCount);
+  if (idx >= 0) connectToNetwork(idx);
+}
+
+void startAPMode() {
+  configMode = true;
+  if (ssid == "") {
+    WiFi.mode(WIFI_AP);
+    WiFi.softAP("NixieGPS");
+  } else {
+    // Concurrent AP+STA: the portal runs on the softAP while the station link,
+    // SNTP and NMEA output keep going. There is only one radio, so the softAP
+    // is started on the channel the station last used (avoids a channel hop
+    // that drops portal clients), limited to a single client to keep beacon
+    // and management airtime low, and modem sleep is disabled so NTP replies
+    // are not held back until the next DTIM.
+    WiFi.mode(WIFI_AP_STA);
+    WiFi.setSleep(false);
+    WiFi.softAP("NixieGPS", NULL, staChannel, 0, 1);
+    connectToBestNetwork();
+  }
+  IPAddress ip = WiFi.softAPIP();
+  Serial.printf("Started AP mode: IP %s\n", ip.toString().c_str());
+  setupWebRoutes();
+  server.begin();
+}
+
+// SNTP's own timer is pushed out beyond the planner's poll period, so every
+// poll after the first is triggered from the planner's NTP slot.
+const uint32_t ntpPollIntervalMs = 3600000;
+unsigned long lastNtpStartMs = 0;
+
+// SNTP reports each sync through a callback in the lwIP task. The round-trip
+// time is measured from the request to that callback on the monotonic
+// esp_timer clock, and the correction is how far the new time is from where
+// the system clock would have been without the sync.
+const uint32_t ntpMaxRttUs = 5000000; // Longer means SNTP retried; not a sample
+
+struct NtpSample {
+  uint32_t rttUs;
+  int64_t correctionUs;
+};
+
+portMUX_TYPE ntpSampleMux = portMUX_INITIALIZER_UNLOCKED;
+NtpSample ntpSampleIn;
+bool ntpSampleReady = false;
+int64_t ntpRequestMonoUs = 0;
+int64_t ntpRequestSysUs = 0;
+
+int64_t systemTimeUs() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void markNtpRequest() {
+  portENTER_CRITICAL(&ntpSampleMux);
+  ntpRequestMonoUs = esp_timer_get_time();
+  ntpRequestSysUs = systemTimeUs();
+  portEXIT_CRITICAL(&ntpSampleMux);
+}
+
+void onNtpSync(struct timeval *tv) {
+  int64_t nowMono = esp_timer_get_time();
+  int64_t newUs = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+  portENTER_CRITICAL(&ntpSampleMux);
+  ntpSampleIn.rttUs = (uint32_t)(nowMono - ntpRequestMonoUs);
+  ntpSampleIn.correctionUs = newUs - (ntpRequestSysUs + (nowMono - ntpRequestMonoUs));
+  ntpSampleReady = true;
+  portEXIT_CRITICAL(&ntpSampleMux);
+}
+
+bool takeNtpSample(NtpSample &out) {
+  bool ready;
+  portENTER_CRITICAL(&ntpSampleMux);
+  ready = ntpSampleReady;
+  out = ntpSampleIn;
+  ntpSampleReady = false;
+  portEXIT_CRITICAL(&ntpSampleMux);
+  return ready;
+}
+
+// With modem sleep an NTP reply can sit at the AP until the next DTIM beacon,
+// adding tens of milliseconds of asymmetric delay. In "auto" mode the radio
+// stays awake from each request until its reply (or a timeout) and sleeps
+// otherwise. Sample quality and radio-awake time are kept per mode so the
+// trade-off can be compared; average current is estimated from the awake
+// fraction using nominal figures, as the board cannot measure it.
+const char *const ntpPsModeNames[NTP_PS_MODE_COUNT] = {"auto", "sleep", "awake"};
+
+const uint32_t ntpExchangeTimeoutMs = 3000;
+const uint32_t radioAwakeCurrentMa = 95;   // Nominal, RX always on
+const uint32_t radioModemSleepCurrentMa = 30; // Nominal, modem sleep DTIM1
+const int rttBucketCount = 7;
+const uint32_t rttBucketUpperUs[rttBucketCount - 1] = {5000, 10000, 20000, 50000, 100000, 200000};
+const int64_t ntpStepThresholdUs = 1000000; // Larger corrections are steps, not jitter
+
+struct NtpPsStats {
+  uint32_t samples;
+  uint32_t rttBuckets[rttBucketCount];
+  uint32_t rttMaxUs;
+  uint32_t jitterSamples;
+  double correctionMean;  // Welford running mean/variance of corrections (us)
+  double correctionM2;
+  uint64_t awakeMs;
+  uint64_t sleepMs;
+};
+
+NtpPsStats ntpPsStats[NTP_PS_MODE_COUNT] = {};
+bool radioAwake = false;
+unsigned long radioStateSince = 0;
+bool ntpExchangeActive = false;
+unsigned long ntpExchangeStart = 0;
+
+// Accounts the time spent in the previous state to the current mode
+void setRadioAwake(bool awake) {
+  unsigned long now = millis();
+  NtpPsStats &st = ntpPsStats[ntpPowerSave];
+  if (radioAwake) {
+    st.awakeMs += now - radioStateSince;
+  } else {
+    st.sleepMs += now - radioStateSince;
+  }
+  radioStateSince = now;
+  // The softAP in AP+STA mode needs the radio on all the time
+  if (configMode) awake = true;
+  if (awake != radioAwake) {
+    esp_wifi_set_ps(awake ? WIFI_PS_NONE : WIFI_PS_MIN_MODEM);
+    radioAwake = awake;
+  }
+}
+
+void applyNtpPowerSave() {
+  setRadioAwake(ntpPowerSave == NTP_PS_AWAKE || (ntpPowerSave == NTP_PS_AUTO && ntpExchangeActive));
+}
+
+void ntpExchangeBegin() {
+  ntpExchangeActive = true;
+  ntpExchangeStart = millis();
+  if (ntpPowerSave == NTP_PS_AUTO) setRadioAwake(true);
+}
+
+void ntpExchangeEnd() {
+  if (!ntpExchangeActive) return;
+  ntpExchangeActive = false;
+  if (ntpPowerSave == NTP_PS_AUTO) setRadioAwake(false);
+}
+
+void recordNtpPsSample(const NtpSample &sample) {
+  NtpPsStats &st = ntpPsStats[ntpPowerSave];
+  st.samples++;
+  int b = 0;
+  while (b < rttBucketCount - 1 && sample.rttUs > rttBucketUpperUs[b]) b++;
+  st.rttBuckets[b]++;
+  if (sample.rttUs > st.rttMaxUs) st.rttMaxUs = sample.rttUs;
+  if (sample.correctionUs > -ntpStepThresholdUs && sample.correctionUs < ntpStepThresholdUs) {
+    st.jitterSamples++;
+    double delta = sample.correctionUs - st.correctionMean;
+    st.correctionMean += delta / st.jitterSamples;
+    st.correctionM2 += delta * (sample.correctionUs - st.correctionMean);
+  }
+}
+
+void printNtpPsStats() {
+  static const char *const bucketNames[rttBucketCount] = {
+    "<5", "<10", "<20", "<50", "<100", "<200", ">=200"
+  };
+  Serial.printf("NTP power save: %s\n", ntpPsModeNames[ntpPowerSave]);
+  for (int m = 0; m < NTP_PS_MODE_COUNT; m++) {
+    const NtpPsStats &st = ntpPsStats[m];
+    uint64_t awakeMs = st.awakeMs;
+    uint64_t sleepMs = st.sleepMs;
+    if (m == ntpPowerSave) {
+      // Include the period that is still running
+      (radioAwake ? awakeMs : sleepMs) += millis() - radioStateSince;
+    }
+    uint64_t totalMs = awakeMs + sleepMs;
+    if (st.samples == 0 && totalMs == 0) continue;
+    uint32_t currentMa = totalMs ? (uint32_t)((awakeMs * radioAwakeCurrentMa +
+                                               sleepMs * radioModemSleepCurrentMa) / totalMs) : 0;
+    double jitterUs = st.jitterSamples > 1 ? sqrt(st.correctionM2 / (st.jitterSamples - 1)) : 0;
+    Serial.printf("  %-5s %lu samples, rtt max %lu us, offset jitter %.0f us, awake %llu%%, ~%lu mA\n",
+                  ntpPsModeNames[m], (unsigned long)st.samples, (unsigned long)st.rttMaxUs, jitterUs,
+                  totalMs ? (unsigned long long)(awakeMs * 100 / totalMs) : 0ULL,
+                  (unsigned long)currentMa);
+    Serial.print("        rtt ms");
+    for (int b = 0; b < rttBucketCount; b++) {
+      Serial.printf(" %s:%lu", bucketNames[b], (unsigned long)st.rttBuckets[b]);
+    }
+    Serial.println();
+  }
+}
+
+// Called from loop(): ends an exchange whose reply never came
+void serviceNtpExchange() {
+  if (ntpExchangeActive && millis() - ntpExchangeStart > ntpExchangeTimeoutMs) {
+    ntpExchangeEnd();
+  }
+}
+
+// Inputs to the time-quality estimate (TimeQuality.h). The drift rate is
+// taken from each slew correction over the time since the previous sample;
+// steps say nothing about the oscillator and leave it unchanged.
+bool ntpEverSynced = false;
+unsigned long ntpLastSyncMs = 0;
+uint32_t ntpLastRttUs = 0;
+uint32_t ntpDriftPpb = 0;
+
+void recordTimeQualitySample(const NtpSample &sample) {
+  unsigned long now = millis();
+  bool slew = sample.correctionUs > -ntpStepThresholdUs && sample.correctionUs < ntpStepThresholdUs;
+  if (ntpEverSynced && slew) {
+    uint32_t ppb = timeQualityDriftPpb(sample.correctionUs, (now - ntpLastSyncMs) / 1000);
+    if (ppb != 0) ntpDriftPpb = ppb;
+  }
+  ntpEverSynced = true;
+  ntpLastSyncMs = now;
+  ntpLastRttUs = sample.rttUs;
+  clockLearn(sample.correctionUs, slew);
+}
+
+// A sync the loop has not taken yet counts as fresh: the first epoch after
+// SNTP sets the clock is emitted before serviceNtpSample() runs.
+TimeQuality currentTimeQuality() {
+  TimeQualityInput in = {};
+  NtpSample pending;
+  bool fresh;
+  portENTER_CRITICAL(&ntpSampleMux);
+  fresh = ntpSampleReady && ntpSampleIn.rttUs <= ntpMaxRttUs;
+  pending = ntpSampleIn;
+  portEXIT_CRITICAL(&ntpSampleMux);
+  if (!timeSet) {
+    in.source = TIME_SOURCE_NONE;
+  } else if (fresh) {
+    in.source = TIME_SOURCE_NTP;
+    in.rttUs = pending.rttUs;
+    in.driftPpb = ntpDriftPpb;
+  } else if (!ntpEverSynced) {
+    in.source = TIME_SOURCE_RTC;
+  } else {
+    in.source = TIME_SOURCE_NTP;
+    in.syncAgeS = (millis() - ntpLastSyncMs) / 1000;
+    in.rttUs = ntpLastRttUs;
+    // The last residual rate only holds while the temperature stays put
+    uint32_t modelPpb = clockModelUncertaintyPpb();
+    in.driftPpb = modelPpb > ntpDriftPpb ? modelPpb : ntpDriftPpb;
+  }
+  return timeQualityFrom(in);
+}
+
+// Called from loop(): attributes the latest sample to the current network
+void serviceNtpSample() {
+  NtpSample sample;
+  if (!takeNtpSample(sample)) return;
+  captureNtpSample(sample.rttUs, sample.correctionUs);
+  ntpExchangeEnd();
+  Serial.printf("NTP sync: rtt %lu us, correction %lld us\n", (unsigned long)sample.rttUs,
+                (long long)sample.correctionUs);
+  if (sample.rttUs <= ntpMaxRttUs) {
+    recordNtpPsSample(sample);
+    recordTimeQualitySample(sample);
+  }
+  if (sample.rttUs <= ntpMaxRttUs && savedNetworkCount > 0) {
+    networkRecordRtt(savedNetworks[currentNetwork].stats, sample.rttUs);
+    networkStatsSavePending = true;
+  }
+}
+
+void startNtp() {
+  lastNtpStartMs = millis();
+  sntp_set_time_sync_notification_cb(onNtpSync);
+  ntpExchangeBegin();
+  markNtpRequest();
+  sntp_set_sync_interval(2 * ntpPollIntervalMs);
+  configTime(0, 0, ntpServer.c_str());
+}
+
+// The mDNS responder is started once and kept running across link flaps, so
+// its records stay registered and the responder only has to re-announce when
+// the station gets an address again. There is no network NMEA or NTP service
+// to advertise, so the NMEA output settings and the time source are published
+// as TXT records on the _http._tcp service.
+bool mdnsStarted = false;
+bool mdnsSyncAdvertised = false;
+
+void updateMdnsTxt() {
+  if (!mdnsStarted) return;
+  char baud[12];
+  FmtBuf b(baud, sizeof(baud));
+  fmtInt(b, baudrate);
+  MDNS.addServiceTxt("http", "tcp", "nmea", nmeaSet == NMEA_SET_FULL ? "GPRMC,GPGGA,GPGSA" : "GPRMC");
+  MDNS.addServiceTxt("http", "tcp", "baud", baud);
+  MDNS.addServiceTxt("http", "tcp", "ntp", ntpServer.c_str());
+  MDNS.addServiceTxt("http", "tcp", "sync", timeSet ? "ok" : "none");
+  mdnsSyncAdvertised = timeSet;
+}
+
+void startMdns() {
+  if (mdnsStarted) return;
+  if (!MDNS.begin(hostname.c_str())) {
+    Serial.println("Error starting mDNS");
+    return;
+  }
+  MDNS.setInstanceName(hostname);
+  MDNS.addService("http", "tcp", 80);
+  mdnsStarted = true;
+  updateMdnsTxt();
+  Serial.printf("mDNS responder started: http://%s.local\n", hostname.c_str());
+}
+
+// Rewriting the TXT records makes the responder announce the service again
+void announceMdns() {
+  if (!mdnsStarted) {
+    startMdns();
+    return;
+  }
+  updateMdnsTxt();
+}
+
+void setMdnsHostname() {
+  if (!mdnsStarted) return;
+  mdns_hostname_set(hostname.c_str());
+  mdns_instance_name_set(hostname.c_str());
+}
+
+void maintainStationLink() {
+  if (WiFi.status() != WL_CONNECTED) {
+    // We are disconnected
+    if (servicesStarted) {
+      Serial.println("WiFi connection lost.");
+      servicesStarted = false; // Reset flag to re-init services on reconnect
+      if (timeSet) startHoldover();
+    }
+    // Improvement: Non-blocking periodic retry
+    unsigned long now = millis();
+    if (now - lastWifiRetry > wifiRetryInterval) {
+      lastWifiRetry = now;
+      Serial.println("Retrying WiFi connection...");
+      connectToBestNetwork();
+    }
+  } else {
+    // We are connected
+    if (!servicesStarted) {
+      // This block runs once upon successful connection
+      Serial.printf("WiFi Connected! IP: %s\n", WiFi.localIP().toString().c_str());
+      if (connectAttemptActive) {
+        connectAttemptActive = false;
+        networkRecordConnect(savedNetworks[currentNetwork].stats, millis() - connectAttemptStart);
+        networkStatsSavePending = true;
+      }
+      saveStaChannel(WiFi.channel());
+      applyNtpPowerSave();
+      startNtp();
+      announceMdns();
+      servicesStarted = true;
+    } else if (mdnsSyncAdvertised != timeSet) {
+      updateMdnsTxt();
+    }
+    serviceNtpSample();
+    serviceNtpExchange();
+  }
+}
+
+
+// =================================================================
+// GPS UART OUTPUT (ESP-IDF DRIVER)
+// =================================================================
+
+// The NMEA stream goes through the ESP-IDF UART driver rather than
+// HardwareSerial so the transmit side can be observed. gpsWrite() copies a
+// burst into the driver's TX ring without blocking; a monitor task then
+// timestamps when the line started shifting it out and when it went idle,
+// tracks ring/FIFO high-water marks and drains the driver's event queue.
+
+const uart_port_t gpsUart = UART_NUM_2;
+const int gpsUartTxBufferSize = 1024;
+const int gpsUartRxBufferSize = 256;      // Driver requires more than the FIFO size
+const int gpsUartRingReserve = 64;        // Headroom for the ring's item headers
+const uint32_t gpsUartFifoLen = 128;
+// One entry per burst the ring can hold, counting every burst as at least
+// one sentence; shorter than any NMEA sentence
+const int gpsTxBurstMin = 40;
+const int gpsTxBurstQueueLen = (gpsUartTxBufferSize - gpsUartRingReserve) / gpsTxBurstMin;
+
+struct TxBurst {
+  uint32_t enqueuedUs;
+  uint32_t firstByteUs; // 0 if the line was not yet seen busy
+  uint16_t len;
+};
+
+struct UartTxStats {
+  uint32_t bursts;
+  uint32_t bytesEnqueued;
+  uint32_t bytesDone;
+  uint32_t overruns;        // Bursts dropped because the ring was full
+  uint32_t fifoOverflows;   // UART_FIFO_OVF events
+  uint32_t bufferFull;      // UART_BUFFER_FULL events
+  uint32_t ringHighWater;   // Bytes waiting in ring + FIFO
+  uint32_t fifoHighWater;
+  uint32_t lastEnqueueUs;
+  uint32_t lastFirstByteUs;
+  uint32_t lastDoneUs;
+  uint32_t lastStartLatencyUs; // Enqueue to first byte on the wire
+  uint32_t lastTxTimeUs;       // Enqueue to line idle
+  uint32_t maxTxTimeUs;
+};
+
+UartTxStats uartTxStats[UART_NUM_MAX] = {};
+QueueHandle_t gpsUartEventQueue = NULL;
+QueueHandle_t gpsTxBurstQueue = NULL;
+
+bool gpsUartIdle() {
+  return uart_ll_is_tx_idle(UART_LL_GET_HW(gpsUart));
+}
+
+uint32_t gpsUartFifoUsed() {
+  return gpsUartFifoLen - uart_ll_get_txfifo_len(UART_LL_GET_HW(gpsUart));
+}
+
+void gpsUartMonitorTask(void *) {
+  UartTxStats &st = uartTxStats[gpsUart];
+  for (;;) {
+    TxBurst burst;
+    if (xQueueReceive(gpsTxBurstQueue, &burst, pdMS_TO_TICKS(100)) == pdTRUE) {
+      uint32_t firstByteUs = burst.firstByteUs;
+      for (;;) {
+        uint32_t fifoUsed = gpsUartFifoUsed();
+        if (fifoUsed > st.fifoHighWater) st.fifoHighWater = fifoUsed;
+        bool idle = gpsUartIdle() && fifoUsed == 0;
+        if (firstByteUs == 0 && !idle) firstByteUs = micros();
+        if (idle && (st.bytesEnqueued - st.bytesDone) <= burst.len) break;
+        if (idle && firstByteUs != 0) break;
+        vTaskDelay(1);
+      }
+      uint32_t doneUs = micros();
+      if (firstByteUs == 0) firstByteUs = doneUs;
+      // Queued behind an earlier burst: it cannot start before that one ended
+      if ((int32_t)(st.lastDoneUs - firstByteUs) > 0 &&
+          (int32_t)(st.lastDoneUs - burst.enqueuedUs) > 0) {
+        firstByteUs = st.lastDoneUs;
+      }
+      st.bytesDone += burst.len;
+      st.lastEnqueueUs = burst.enqueuedUs;
+      st.lastFirstByteUs = firstByteUs;
+      st.lastDoneUs = doneUs;
+      st.lastStartLatencyUs = firstByteUs - burst.enqueuedUs;
+      st.lastTxTimeUs = doneUs - burst.enqueuedUs;
+      if (st.lastTxTimeUs > st.maxTxTimeUs) st.maxTxTimeUs = st.lastTxTimeUs;
+    }
+
+    uart_event_t event;
+    while (xQueueReceive(gpsUartEventQueue, &event, 0) == pdTRUE) {
+      if (event.type == UART_FIFO_OVF) {
+        st.fifoOverflows++;
+        uart_flush_input(gpsUart);
+      } else if (event.type == UART_BUFFER_FULL) {
+        st.bufferFull++;
+        uart_flush_input(gpsUart);
+      }
+    }
+  }
+}
+
+void gpsUartBegin(int baud) {
+  uart_config_t config = {};
+  config.baud_rate = baud;
+  config.data_bits = UART_DATA_8_BITS;
+  config.parity = UART_PARITY_DISABLE;
+  config.stop_bits = UART_STOP_BITS_1;
+  config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+  config.source_clk = UART_SCLK_APB;
+  uart_driver_install(gpsUart, gpsUartRxBufferSize, gpsUartTxBufferSize, 16, &gpsUartEventQueue, 0);
+  uart_param_config(gpsUart, &config);
+  uart_set_pin(gpsUart, GPS_TX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+
+  gpsTxBurstQueue = xQueueCreate(gpsTxBurstQueueLen, sizeof(TxBurst));
+  // Above the loop task so timestamps are taken promptly; it sleeps on the
+  // burst queue and only polls the line while a burst is in flight.
+  xTaskCreatePinnedToCore(gpsUartMonitorTask, "uartmon", 2048, NULL, 2, NULL, 0);
+}
+
+void gpsUartSetBaud(int baud) {
+  uart_set_baudrate(gpsUart, baud);
+}
+
+bool gpsTxFits(size_t len) {
+  const UartTxStats &st = uartTxStats[gpsUart];
+  uint32_t pending = st.bytesEnqueued - st.bytesDone;
+  return pending + len <= (uint32_t)(gpsUartTxBufferSize - gpsUartRingReserve);
+}
+
+// Never blocks: if the ring cannot take the whole burst, or the monitor could
+// not account for it, it is dropped and counted as an overrun. A burst the
+// monitor never sees would stay pending and shrink the ring for good.
+bool gpsWrite(const char *data, size_t len) {
+  UartTxStats &st = uartTxStats[gpsUart];
+  uint32_t pending = st.bytesEnqueued - st.bytesDone;
+  if (!gpsTxFits(len) || uxQueueSpacesAvailable(gpsTxBurstQueue) == 0) {
+    st.overruns++;
+    return false;
+  }
+  TxBurst burst;
+  burst.enqueuedUs = micros();
+  burst.len = len;
+  uart_write_bytes(gpsUart, data, len);
+  burst.firstByteUs = (pending == 0 && !gpsUartIdle()) ? micros() : 0;
+
+  st.bursts++;
+  st.bytesEnqueued += len;
+  pending += len;
+  if (pending > st.ringHighWater) st.ringHighWater = pending;
+  xQueueSend(gpsTxBurstQueue, &burst, 0);
+  return true;
+}
+
+void printUartStats(uart_port_t port) {
+  const UartTxStats &st = uartTxStats[port];
+  Serial.printf("UART%d: %lu bursts, %lu bytes, %lu overruns, %lu FIFO ovf, %lu buffer full\n",
+                (int)port, (unsigned long)st.bursts, (unsigned long)st.bytesEnqueued,
+                (unsigned long)st.overruns, (unsigned long)st.fifoOverflows,
+                (unsigned long)st.bufferFull);
+  Serial.printf("  high water: ring %lu of %d, FIFO %lu of %lu\n",
+                (unsigned long)st.ringHighWater, gpsUartTxBufferSize,
+                (unsigned long)st.fifoHighWater, (unsigned long)gpsUartFifoLen);
+  // The monitor polls the line once per tick, so these are good to about 1 ms
+  Serial.printf("  last burst: start +%lu us, done +%lu us (max %lu us, 1 ms resolution)\n",
+                (unsigned long)st.lastStartLatencyUs, (unsigned long)st.lastTxTimeUs,
+                (unsigned long)st.maxTxTimeUs);
+}
+
+// =================================================================
+// GPS EMULATION
+// =================================================================
+
+// XOR of all characters between the leading '$' and '*' (or the end)
+uint8_t calculateChecksum(const char *sentence) {
+  uint8_t checksum = 0;
+  for (const char *p = sentence + 1; *p != '\0' && *p != '*'; p++) {
+    checksum ^= (uint8_t)*p;
+  }
+  return checksum;
+}
+
+// Terminates a '$'-prefixed sentence with "*hh\r\n"
+void appendChecksum(FmtBuf &out) {
+  uint8_t checksum = calculateChecksum(out.start);
+  fmtChar(out, '*');
+  fmtHex2(out, checksum);
+  fmtStr(out, "\r\n");
+}
+
+const size_t nmeaEpochMax = 256;
+
+// The quality-dependent fields, rendered once per second by
+// updateNmeaQuality() from the clock job, off the emission edge, so encoding
+// an epoch only copies them
+struct NmeaQualityFields {
+  TimeQuality quality;
+  char gga[32];   // Fix quality through the end of the sentence
+  char gsa[64];   // Everything after "$GPGSA,"
+};
+
+NmeaQualityFields nmeaQuality;
+bool nmeaQualityTimeSet = false; // timeSet when nmeaQuality was rendered
+NmeaQualityFields synthQuality; // Always good: the generator's time is exact by definition
+
+void renderNmeaQuality(NmeaQualityFields &f, const TimeQuality &q) {
+  f.quality = q;
+  FmtBuf gga(f.gga, sizeof(f.gga));
+  fmtUint(gga, q.ggaQuality);
+  fmtChar(gga, ',');
+  fmtUint(gga, q.satellites, 2);
+  fmtChar(gga, ',');
+  fmtFixed(gga, q.hdop10, 1);
+  fmtStr(gga, ",0.0,M,0.0,M,,");
+
+  // PDOP and VDOP are derived from HDOP with a typical geometry ratio
+  FmtBuf gsa(f.gsa, sizeof(f.gsa));
+  fmtStr(gsa, "A,");
+  fmtUint(gsa, q.gsaMode);
+  for (int prn = 1; prn <= 12; prn++) {
+    fmtChar(gsa, ',');
+    if (prn <= q.satellites) fmtUint(gsa, prn, 2);
+  }
+  fmtChar(gsa, ',');
+  fmtFixed(gsa, q.hdop10 < 666 ? q.hdop10 * 3 / 2 : 999, 1);
+  fmtChar(gsa, ',');
+  fmtFixed(gsa, q.hdop10, 1);
+  fmtChar(gsa, ',');
+  fmtFixed(gsa, q.hdop10 < 832 ? q.hdop10 * 6 / 5 : 999, 1);
+}
+
+void updateNmeaQuality() {
+  renderNmeaQuality(nmeaQuality, currentTimeQuality());
+  nmeaQualityTimeSet = timeSet;
+}
+
+// The USB log can block on a full FIFO, so emitted lines are kept here and
+// printed from the planner's log slot instead of the emission path.
+char gpsLogLine[nmeaEpochMax];
+bool gpsLogPending = false;
+
+void queueGpsLog(const char *line, size_t len) {
+  if (len >= sizeof(gpsLogLine)) len = sizeof(gpsLogLine) - 1;
+  memcpy(gpsLogLine, line, len);
+  gpsLogLine[len] = '\0';
+  gpsLogPending = true;
+}
+
+void flushGpsLog() {
+  if (!gpsLogPending) return;
+  gpsLogPending = false;
+  Serial.print("GPS output: ");
+  Serial.print(gpsLogLine);
+}
+
+void fmtUtcTime(FmtBuf &out, const struct tm *tm_struct) {
+  fmt2(out, tm_struct->tm_hour);
+  fmt2(out, tm_struct->tm_min);
+  fmt2(out, tm_struct->tm_sec);
+  fmtStr(out, ".000,");
+}
+
+size_t formatRMC(char *buf, size_t size, const struct tm *tm_struct, const NmeaQualityFields &q) {
+  FmtBuf out(buf, size);
+  fmtStr(out, "$GPRMC,");
+  fmtUtcTime(out, tm_struct);
+  fmtChar(out, q.quality.rmcStatus);
+  fmtStr(out, ",0000.0000,N,00000.0000,E,0.0,0.0,");
+  fmt2(out, tm_struct->tm_mday);
+  fmt2(out, tm_struct->tm_mon + 1);
+  fmt2(out, (tm_struct->tm_year + 1900) % 100);
+  fmtStr(out, ",,,");
+  fmtChar(out, q.quality.rmcMode);
+  appendChecksum(out);
+  return out.length();
+}
+
+size_t formatGGA(char *buf, size_t size, const struct tm *tm_struct, const NmeaQualityFields &q) {
+  FmtBuf out(buf, size);
+  fmtStr(out, "$GPGGA,");
+  fmtUtcTime(out, tm_struct);
+  fmtStr(out, "0000.0000,N,00000.0000,E,");
+  fmtStr(out, q.gga);
+  appendChecksum(out);
+  return out.length();
+}
+
+size_t formatGSA(char *buf, size_t size, const NmeaQualityFields &q) {
+  FmtBuf out(buf, size);
+  fmtStr(out, "$GPGSA,");
+  fmtStr(out, q.gsa);
+  appendChecksum(out);
+  return out.length();
+}
+
+// Everything sent for one epoch; shared by outputGPS() and the synthetic
+// time generator. `size` must leave room for every sentence in the set.
+size_t encodeEpoch(char *buf, size_t size, const struct tm *tm_struct, const NmeaQualityFields &q) {
+  size_t len = formatRMC(buf, size, tm_struct, q);
+  if (nmeaSet == NMEA_SET_FULL) {
+    len += formatGGA(buf + len, size - len, tm_struct, q);
+    len += formatGSA(buf + len, size - len, q);
+  }
+  return len;
+}
+
+// The baseline's emission path, kept as a backend for comparison: each
+// sentence is printed with sprintf, wrapped in Strings and checksummed as a
+// String. The bytes are identical to encodeEpoch()'s.
+String legacyChecksum(const String &sentence) {
+  uint8_t checksum = 0;
+  for (size_t i = 1; i < sentence.length(); i++) {
+    if (sentence[i] == '*') break;
+    checksum ^= sentence[i];
+  }
+  char cs[3];
+  sprintf(cs, "%02X", checksum);
+  return String(cs);
+}
+
+String legacySentence(const char *body) {
+  String sentence = String(body);
+  String checksum = legacyChecksum("$" + sentence);
+  return "$" + sentence + "*" + checksum + "\r\n";
+}
+
+size_t encodeEpochLegacy(char *buf, size_t size, const struct tm *tm_struct, const NmeaQualityFields &q) {
+  char buffer[96];
+  snprintf(buffer, sizeof(buffer), "GPRMC,%02d%02d%02d.000,%c,0000.0000,N,00000.0000,E,0.0,0.0,%02d%02d%02d,,,%c",
+           tm_struct->tm_hour, tm_struct->tm_min, tm_struct->tm_sec, q.quality.rmcStatus,
+           tm_struct->tm_mday, tm_struct->tm_mon + 1, (tm_struct->tm_year + 1900) % 100, q.quality.rmcMode);
+  String gpsLine = legacySentence(buffer);
+  if (nmeaSet == NMEA_SET_FULL) {
+    snprintf(buffer, sizeof(buffer), "GPGGA,%02d%02d%02d.000,0000.0000,N,00000.0000,E,%s",
+             tm_struct->tm_hour, tm_struct->tm_min, tm_struct->tm_sec, q.gga);
+    gpsLine += legacySentence(buffer);
+    snprintf(buffer, sizeof(buffer), "GPGSA,%s", q.gsa);
+    gpsLine += legacySentence(buffer);
+  }
+  return strlcpy(buf, gpsLine.c_str(), size) < size ? gpsLine.length() : size - 1;
+}
+
+bool transmitNothing(const char *, size_t) {
+  return true;
+}
+
+// An emission backend turns one epoch into bytes and hands them to a
+// transport. outputGPS() goes through the selected one; 'emit' switches
+// backends and benchmarks them against each other. Backends that do not
+// reach the wire are only used by the benchmark.
+struct EmissionBackend {
+  const char *name;
+  size_t (*encode)(char *buf, size_t size, const struct tm *tm_struct, const NmeaQualityFields &q);
+  bool (*transmit)(const char *data, size_t len); // false: dropped
+  bool reachesWire;
+};
+
+const EmissionBackend emissionBackends[] = {
+  {"fast",   encodeEpoch,       gpsWrite,        true},  // FastFormat into the UART driver's ring
+  {"legacy", encodeEpochLegacy, gpsWrite,        true},  // sprintf and String, same transport
+  {"null",   encodeEpoch,       transmitNothing, false}, // Encoding alone
+};
+const int emissionBackendCount = sizeof(emissionBackends) / sizeof(emissionBackends[0]);
+int emissionBackend = 0;
+
+// Heap allocations made by the emitting task while a backend runs. They are
+// counted by the malloc wrappers of the bench build (env:esp32dev-bench) or
+// by the host replayer; otherwise they cannot be seen.
+#if defined(EMIT_BENCH_ALLOCS) || defined(EMIT_BENCH_ALLOCS_EXTERNAL)
+const bool emitAllocsCounted = true;
+#else
+const bool emitAllocsCounted = false;
+#endif
+TaskHandle_t emitAllocTask = NULL;     // Set while counting
+volatile uint32_t emitAllocs = 0;
+
+void noteEmitAlloc() {
+  if (emitAllocTask != NULL && xTaskGetCurrentTaskHandle() == emitAllocTask) emitAllocs++;
+}
+
+#ifdef EMIT_BENCH_ALLOCS
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  noteEmitAlloc();
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  noteEmitAlloc();
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+  noteEmitAlloc();
+  return __real_realloc(p, size);
+}
+}
+#endif
+
+// Per-epoch figures for the benchmark, filled in by outputGPS() while
+// active. The harness reads them from a planner job, so nothing is printed
+// from the emission path.
+const int emitMeasureWarmup = 2;       // Epochs skipped after a backend switch
+const int emitMeasureMax = 600;
+
+struct EmissionMeasure {
+  bool active;
+  int warmup;
+  uint32_t epochs;
+  uint64_t encodeCycles;
+  uint64_t transmitCycles;
+  uint32_t maxEncodeCycles;
+  uint32_t maxTransmitCycles;
+  uint32_t bytes;
+  uint32_t allocs;
+  uint32_t drops;
+  uint32_t offsetsUs[emitMeasureMax];  // Phase after the hand-off to the transport
+};
+
+EmissionMeasure emitMeasure = {};
+
+void emitMeasureBegin() {
+  emitMeasure = EmissionMeasure();
+  emitMeasure.warmup = emitMeasureWarmup;
+  emitMeasure.active = true;
+}
+
+void emitMeasureRecord(uint32_t encodeCycles, uint32_t transmitCycles, size_t len, uint32_t allocs,
+                       bool sent, uint32_t offsetUs) {
+  if (emitMeasure.warmup > 0) {
+    emitMeasure.warmup--;
+    return;
+  }
+  if (emitMeasure.epochs >= (uint32_t)emitMeasureMax) return;
+  EmissionMeasure &m = emitMeasure;
+  m.offsetsUs[m.epochs++] = offsetUs;
+  m.encodeCycles += encodeCycles;
+  m.transmitCycles += transmitCycles;
+  if (encodeCycles > m.maxEncodeCycles) m.maxEncodeCycles = encodeCycles;
+  if (transmitCycles > m.maxTransmitCycles) m.maxTransmitCycles = transmitCycles;
+  m.bytes += len;
+  m.allocs += allocs;
+  if (!sent) m.drops++;
+}
+
+void outputGPS() {
+  struct timeval tv;
+  if (gettimeofday(&tv, NULL) != 0) return;
+
+  time_t now = tv.tv_sec;
+  struct tm *tm_struct = gmtime(&now);
+
+  const EmissionBackend &backend = emissionBackends[emissionBackend];
+  char gpsLine[nmeaEpochMax];
+  if (emitMeasure.active) {
+    emitAllocs = 0;
+    emitAllocTask = xTaskGetCurrentTaskHandle();
+  }
+  uint32_t start = ESP.getCycleCount();
+  size_t len = backend.encode(gpsLine, sizeof(gpsLine), tm_struct, nmeaQuality);
+  uint32_t encoded = ESP.getCycleCount();
+  bool sent = backend.transmit(gpsLine, len);
+  uint32_t done = ESP.getCycleCount();
+  emitAllocTask = NULL;
+
+  stallMonitorEmission();
+  queueGpsLog(gpsLine, len);
+  if (emitMeasure.active) {
+    struct timeval after;
+    gettimeofday(&after, NULL);
+    emitMeasureRecord(encoded - start, done - encoded, len, emitAllocs, sent, after.tv_usec);
+  }
+}
+
+// =================================================================
+// SYNTHETIC TIME GENERATOR
+// =================================================================
+
+// For qualifying receivers: emits made-up time from an arbitrary start date
+// (leap days, month ends, the 2099 -> 2100 two-digit year wrap), advancing
+// `step` seconds per sentence at `rate` sentences per second, or as fast as
+// the UART drains when rate is 0. Sentences go through encodeEpoch() and
+// gpsWrite() exactly like real ones; normal emission pauses meanwhile.
+
+const int syntheticBurstMax = 8; // Sentences per loop iteration at most
+
+struct SyntheticTime {
+  bool active;
+  int64_t epoch;       // Seconds since 1970, 64-bit so 2038+ works
+  uint32_t step;
+  uint32_t rate;       // Sentences per second, 0 = limited by the UART only
+  uint32_t startUs;
+  uint32_t nextUs;
+  uint32_t sentences;
+  uint32_t bytes;
+  uint32_t ringFull;   // Sentences held back because the TX ring was full
+  uint32_t uartDoneStart;
+};
+
+SyntheticTime synth = {};
+
+void startSynthetic(int64_t epoch, uint32_t rate, uint32_t step) {
+  synth = SyntheticTime();
+  synth.active = true;
+  synth.epoch = epoch;
+  synth.rate = rate;
+  synth.step = step;
+  synth.startUs = micros();
+  synth.nextUs = synth.startUs;
+  synth.uartDoneStart = uartTxStats[gpsUart].bytesDone;
+  lastEmissionUs = 0; // The stall monitor restarts with the next real epoch
+  TimeQualityInput in = {};
+  in.source = TIME_SOURCE_SYNTHETIC;
+  renderNmeaQuality(synthQuality, timeQualityFrom(in));
+}
+
+void stopSynthetic() {
+  synth.active = false;
+  lastEmissionUs = 0;
+}
+
+void printSyntheticStats() {
+  uint32_t elapsedUs = micros() - synth.startUs;
+  if (elapsedUs == 0) elapsedUs = 1;
+  uint32_t wireBytes = uartTxStats[gpsUart].bytesDone - synth.uartDoneStart;
+  uint32_t limitBps = baudrate / 10; // 8N1: 10 bits per byte
+  uint32_t wireBps = (uint32_t)((uint64_t)wireBytes * 1000000 / elapsedUs);
+  struct tm t;
+  civilFromEpoch(synth.epoch, t);
+  Serial.printf("Synthetic %s: now %04d-%02d-%02d %02d:%02d:%02d, %lu sentences in %lu ms\n",
+                synth.active ? "running" : "stopped", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
+                t.tm_hour, t.tm_min, t.tm_sec, (unsigned long)synth.sentences,
+                (unsigned long)(elapsedUs / 1000));
+  Serial.printf("  %lu sentences/s, wire %lu of %lu bytes/s (%lu%%), ring full %lu\n",
+                (unsigned long)((uint64_t)synth.sentences * 1000000 / elapsedUs),
+                (unsigned long)wireBps, (unsigned long)limitBps,
+                (unsigned long)(limitBps ? wireBps * 100 / limitBps : 0),
+                (unsigned long)synth.ringFull);
+}
+
+// Called from loop()
+void serviceSynthetic() {
+  if (!synth.active) return;
+  for (int i = 0; i < syntheticBurstMax; i++) {
+    if (synth.rate != 0 && (int32_t)(micros() - synth.nextUs) < 0) return;
+    struct tm t;
+    civilFromEpoch(synth.epoch, t);
+    char line[nmeaEpochMax];
+    size_t len = encodeEpoch(line, sizeof(line), &t, synthQuality);
+    if (!gpsTxFits(len)) {
+      // Hold the epoch and try again once the UART has drained
+      synth.ringFull++;
+      return;
+    }
+    gpsWrite(line, len);
+    synth.sentences++;
+    synth.bytes += len;
+    synth.epoch += synth.step;
+    if (synth.rate != 0) synth.nextUs += 1000000UL / synth.rate;
+  }
+}
+
+// =================================================================
+// DISPLAY MANAGEMENT
+// =================================================================
+
+// Dotted quad into a caller buffer; IPAddress::toString() allocates a String
+const char *formatIp(char *buf, size_t size, const IPAddress &ip) {
+  FmtBuf out(buf, size);
+  for (int i = 0; i < 4; i++) {
+    if (i) fmtChar(out, '.');
+    fmtUint(out, ip[i]);
+  }
+  return buf;
+}
+
+// Rendering runs in its own task so the cost of a frame never shows up in
+// loop(). The planner's display job only copies the state the screen needs
+// into a snapshot and overwrites the one-slot mailbox; the task renders
+// whatever snapshot is newest. A snapshot replaced before the task got to it
+// is a dropped frame, and one that waited longer than displayStaleMs is
+// skipped rather than drawn late. The task owns the TFT and the sprite
+// exclusively, including rotation changes.
+
+enum DisplayScreen : uint8_t { SCREEN_AP, SCREEN_CONNECTING, SCREEN_CONNECTED, SCREEN_TEST };
+
+struct DisplaySnapshot {
+  DisplayScreen screen;
+  bool staConfigured;     // AP+STA: a network is saved
+  bool staConnected;
+  bool timeSet;
+  uint8_t rotation;
+  uint8_t quality;        // TimeQualityLevel
+  uint8_t ip[4];          // softAP address on the AP screen, station otherwise
+  char ssid[33];
+  char hostname[33];
+  time_t sec;
+  uint32_t takenUs;
+};
+
+struct DisplayStats {
+  uint32_t published;
+  uint32_t rendered;
+  uint32_t dropped;       // Overwritten before the task picked them up
+  uint32_t stale;         // Picked up too late and skipped
+  uint32_t lastRenderUs;
+  uint32_t maxRenderUs;
+  uint64_t totalRenderUs;
+  uint32_t fpsMilli;      // Frames per 1000 s over the last window
+  uint32_t windowStartUs;
+  uint32_t windowFrames;
+};
+
+const uint32_t displayStaleMs = 1000;
+const uint32_t displayFpsWindowUs = 10000000;
+
+QueueHandle_t displayMailbox = NULL;
+DisplayStats displayStats = {};
+
+void drawTestPattern() {
+  const uint16_t bars[] = {TFT_WHITE, TFT_YELLOW, TFT_CYAN, TFT_GREEN,
+                           TFT_MAGENTA, TFT_RED, TFT_BLUE, TFT_BLACK};
+  int w = sprite.width() / 8;
+  for (int i = 0; i < 8; i++) {
+    sprite.fillRect(i * w, 0, (i == 7) ? sprite.width() - 7 * w : w, sprite.height(), bars[i]);
+  }
+  sprite.pushSprite(0, 0);
+}
+
+void renderDisplay(const DisplaySnapshot &snap) {
+  if (snap.screen == SCREEN_TEST) {
+    drawTestPattern();
+    return;
+  }
+  char ipbuf[16];
+  IPAddress ip(snap.ip[0], snap.ip[1], snap.ip[2], snap.ip[3]);
+  sprite.fillSprite(TFT_BLACK);
+
+  if (snap.screen == SCREEN_AP) {
+    // AP Mode display
+    sprite.setTextSize(3);
+    sprite.setTextColor(TFT_ORANGE);
+    sprite.setCursor(40, 20);
+    sprite.println("AP Mode");
+
+    sprite.setTextSize(2);
+    sprite.setCursor(5, 70);
+    sprite.setTextColor(TFT_WHITE);
+    sprite.print("IP: ");
+    sprite.setTextColor(TFT_CYAN);
+    sprite.println(formatIp(ipbuf, sizeof(ipbuf), ip));
+
+    if (snap.staConfigured) {
+      // AP+STA: show whether the clock is still being fed
+      sprite.setCursor(5, 100);
+      sprite.setTextColor(TFT_WHITE);
+      sprite.print("STA: ");
+      if (!snap.staConnected) {
+        sprite.setTextColor(TFT_ORANGE);
+        sprite.print("Connecting...");
+      } else if (snap.timeSet) {
+        sprite.setTextColor(TFT_GREEN);
+        sprite.print("NTP OK");
+      } else {
+        sprite.setTextColor(TFT_WHITE);
+        sprite.print("Syncing...");
+      }
+    }
+  } else if (snap.screen == SCREEN_CONNECTING) {
+    // Improvement: New state for Connecting / Reconnecting
+    sprite.setTextSize(3);
+    sprite.setTextColor(TFT_ORANGE);
+    sprite.setCursor(10, 20);
+    sprite.println("Connecting...");
+
+    sprite.setTextSize(2);
+    sprite.setCursor(5, 70);
+    sprite.setTextColor(TFT_WHITE);
+    sprite.print("SSID: ");
+    sprite.setTextColor(TFT_CYAN);
+    sprite.println(snap.ssid);
+  } else {
+    // Normal connected display
+    sprite.setTextColor(TFT_WHITE);
+    sprite.setTextSize(2);
+    sprite.setCursor(5, 0);
+    sprite.print("Host: ");
+    sprite.setTextColor(TFT_CYAN);
+    sprite.print(snap.hostname);
+
+    sprite.setCursor(5, 30);
+    sprite.setTextColor(TFT_WHITE);
+    sprite.print("IP: ");
+    sprite.setTextColor(TFT_CYAN);
+    sprite.print(formatIp(ipbuf, sizeof(ipbuf), ip));
+
+    sprite.setCursor(5, 60);
+    sprite.setTextColor(TFT_WHITE);
+    sprite.print("NTP: ");
+    
+    if (snap.timeSet && snap.quality >= TIME_QUALITY_DEGRADED) {
+      sprite.setTextColor(snap.quality == TIME_QUALITY_GOOD ? TFT_GREEN : TFT_YELLOW);
+      sprite.print(snap.quality == TIME_QUALITY_GOOD ? "OK" : "Degraded");
+    } else if (snap.timeSet) {
+      sprite.setTextColor(TFT_ORANGE);
+      sprite.print(timeQualityNames[snap.quality]);
+    } else {
+      sprite.setTextColor(TFT_WHITE);
+      sprite.print("Syncing...");
+    }
+
+    sprite.setCursor(5, 90);
+    if (snap.timeSet) {
+      struct tm tm_buf;
+      struct tm *tm_struct = gmtime_r(&snap.sec, &tm_buf);
+      sprite.setTextSize(3);
+      char timebuf[20];
+      FmtBuf text(timebuf, sizeof(timebuf));
+      fmt2(text, tm_struct->tm_hour);
+      fmtChar(text, ':');
+      fmt2(text, tm_struct->tm_min);
+      fmtChar(text, ':');
+      fmt2(text, tm_struct->tm_sec);
+      fmtStr(text, " UTC");
+      sprite.setTextColor(TFT_CYAN);
+      sprite.print(timebuf);
+    } else {
+      sprite.setTextSize(2);
+      sprite.setTextColor(TFT_CYAN);
+      sprite.print("Waiting for NTP...");
+    }
+  }
+  sprite.pushSprite(0, 0);
+}
+
+// Waits up to `wait` for a snapshot and renders it; display task only
+void displayRenderNext(TickType_t wait) {
+  static uint8_t rotation = screenRotation;
+  DisplaySnapshot snap;
+  if (xQueueReceive(displayMailbox, &snap, wait) != pdTRUE) return;
+  uint32_t start = micros();
+  if (start - snap.takenUs > displayStaleMs * 1000) {
+    displayStats.stale++;
+    return;
+  }
+  if (snap.rotation != rotation) {
+    rotation = snap.rotation;
+    tft.setRotation(rotation);
+  }
+  renderDisplay(snap);
+  uint32_t end = micros();
+  uint32_t elapsed = end - start;
+  displayStats.rendered++;
+  displayStats.lastRenderUs = elapsed;
+  displayStats.totalRenderUs += elapsed;
+  if (elapsed > displayStats.maxRenderUs) displayStats.maxRenderUs = elapsed;
+  displayStats.windowFrames++;
+  uint32_t windowUs = end - displayStats.windowStartUs;
+  if (windowUs >= displayFpsWindowUs) {
+    displayStats.fpsMilli = (uint32_t)((uint64_t)displayStats.windowFrames * 1000000000ULL / windowUs);
+    displayStats.windowStartUs = end;
+    displayStats.windowFrames = 0;
+  }
+}
+
+void displayTask(void *) {
+  for (;;) displayRenderNext(portMAX_DELAY);
+}
+
+void startDisplay() {
+  displayMailbox = xQueueCreate(1, sizeof(DisplaySnapshot));
+  displayStats.windowStartUs = micros();
+  // Core 0 at priority 1 like the console: below WiFi/lwIP, and the loop
+  // task on core 1 never waits for a frame.
+  xTaskCreatePinnedToCore(displayTask, "display", 4096, NULL, 1, NULL, 0);
+}
+
+// Planner job: captures the state to show and hands it to the display task
+void publishDisplay() {
+  if (displayMailbox == NULL) return;
+  DisplaySnapshot snap;
+  memset(&snap, 0, sizeof(snap));
+  bool connected = WiFi.status() == WL_CONNECTED;
+  IPAddress ip;
+  if ((long)(testPatternUntil - millis()) > 0) {
+    snap.screen = SCREEN_TEST;
+  } else if (configMode) {
+    snap.screen = SCREEN_AP;
+    ip = WiFi.softAPIP();
+  } else if (!connected) {
+    snap.screen = SCREEN_CONNECTING;
+  } else {
+    snap.screen = SCREEN_CONNECTED;
+    ip = WiFi.localIP();
+  }
+  for (int i = 0; i < 4; i++) snap.ip[i] = ip[i];
+  snap.staConfigured = ssid != "";
+  snap.staConnected = connected;
+  snap.timeSet = timeSet;
+  snap.rotation = screenRotation;
+  snap.quality = currentTimeQuality().level;
+  strlcpy(snap.ssid, ssid.c_str(), sizeof(snap.ssid));
+  strlcpy(snap.hostname, hostname.c_str(), sizeof(snap.hostname));
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  snap.sec = tv.tv_sec;
+  snap.takenUs = micros();
+
+  if (uxQueueMessagesWaiting(displayMailbox) > 0) displayStats.dropped++;
+  xQueueOverwrite(displayMailbox, &snap);
+  displayStats.published++;
+}
+
+void printDisplayStats() {
+  const DisplayStats &st = displayStats;
+  Serial.printf("Display: %lu published, %lu rendered, %lu dropped, %lu stale\n",
+                (unsigned long)st.published, (unsigned long)st.rendered, (unsigned long)st.dropped,
+                (unsigned long)st.stale);
+  Serial.printf("  render last %lu us, avg %lu us, max %lu us, %lu.%03lu fps\n",
+                (unsigned long)st.lastRenderUs,
+                (unsigned long)(st.rendered ? st.totalRenderUs / st.rendered : 0),
+                (unsigned long)st.maxRenderUs, (unsigned long)(st.fpsMilli / 1000),
+                (unsigned long)(st.fpsMilli % 1000));
+}
+
+// =================================================================
+// RUNTIME SETTINGS & FLEET PUSH
+// =================================================================
+
+// Settings that can change without a restart. The console's 'set' and fleet
+// pushes both go through applySetting(); with apply false it only validates.
+// Returns NULL on success, otherwise what was wrong with the value.
+const char *applySetting(const char *key, const char *value, bool apply) {
+  if (strcmp(key, "hostname") == 0) {
+    if (!apply) return NULL;
+    hostname = value;
+    setMdnsHostname();
+  } else if (strcmp(key, "ntp") == 0) {
+    if (!apply) return NULL;
+    ntpServer = value;
+    if (servicesStarted) startNtp();
+    updateMdnsTxt();
+  } else if (strcmp(key, "baud") == 0) {
+    int b = atoi(value);
+    if (b < 300 || b > 921600) return "invalid baudrate";
+    if (!apply) return NULL;
+    baudrate = b;
+    gpsUartSetBaud(baudrate);
+    updateMdnsTxt();
+  } else if (strcmp(key, "ntpps") == 0) {
+    int mode = -1;
+    for (int m = 0; m < NTP_PS_MODE_COUNT; m++) {
+      if (strcmp(value, ntpPsModeNames[m]) == 0) mode = m;
+    }
+    if (mode < 0) return "must be auto, sleep or awake";
+    if (!apply) return NULL;
+    setRadioAwake(radioAwake); // Close the accounting period of the old mode
+    ntpPowerSave = mode;
+    if (WiFi.status() == WL_CONNECTED) applyNtpPowerSave();
+  } else if (strcmp(key, "nmea") == 0) {
+    int set = -1;
+    for (int i = 0; i < NMEA_SET_COUNT; i++) {
+      if (strcmp(value, nmeaSetNames[i]) == 0) set = i;
+    }
+    if (set < 0) return "must be rmc or full";
+    if (!apply) return NULL;
+    nmeaSet = set;
+    updateMdnsTxt();
+  } else if (strcmp(key, "rotation") == 0) {
+    int r = atoi(value);
+    if (r != 1 && r != 3) return "must be 1 or 3";
+    if (!apply) return NULL;
+    screenRotation = r; // Applied by the display task with the next frame
+  } else {
+    return "unknown setting";
+  }
+  return NULL;
+}
+
+// While the station link is up and a fleet key is set, the unit listens on
+// a multicast group for signed settings deltas (FleetConfig.h) and applies
+// them live, so a rollout is one burst of packets instead of a portal visit
+// and a restart per unit. Every push is answered with a 16-byte ack to its
+// sender, held back by a delay derived from the MAC so a large fleet does
+// not answer in the same instant. Only the latest ack is kept.
+
+const IPAddress fleetGroup(239, 255, 71, 80);
+const uint16_t fleetPort = 7147;
+const uint32_t fleetAckSpreadMs = 500;
+const int fleetPacketsPerRun = 4;      // A burst repeats each packet
+
+struct FleetStats {
+  uint32_t packets;
+  uint32_t malformed;
+  uint32_t badSignature;
+  uint32_t acks[FLEET_ACK_STATUS_COUNT];
+};
+
+WiFiUDP fleetUdp;
+bool fleetListening = false;
+FleetStats fleetStats = {};
+
+bool fleetAckPending = false;
+unsigned long fleetAckDueMs = 0;
+IPAddress fleetAckIp;
+uint16_t fleetAckPort = 0;
+FleetAckStatus fleetAckStatus = FLEET_ACK_CURRENT;
+
+bool fleetSignatureValid(const uint8_t *p, size_t len) {
+  uint8_t mac[fleetMacSize];
+  const mbedtls_md_info_t *md = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+  if (mbedtls_md_hmac(md, fleetKey, sizeof(fleetKey), p, fleetSignedLength(len), mac) != 0) return false;
+  return fleetMacEqual(mac, p + fleetSignedLength(len));
+}
+
+// Every value is validated before any is applied, so a push that carries a
+// bad value leaves the unit as it was
+FleetAckStatus applyFleetDelta(const FleetDelta &d) {
+  FleetAckStatus status = fleetVersionCheck(fleetVersion, d);
+  if (status != FLEET_ACK_APPLIED) return status;
+  char values[fleetEntriesMax][fleetValueMax + 1];
+  for (int i = 0; i < d.count; i++) {
+    const FleetEntry &e = d.entries[i];
+    memcpy(values[i], e.value, e.len);
+    values[i][e.len] = '\0';
+    const char *error = applySetting(fleetKeyNames[e.key], values[i], false);
+    if (error != NULL) {
+      Serial.printf("Fleet config version %lu rejected, %s: %s\n", (unsigned long)d.version,
+                    fleetKeyNames[e.key], error);
+      return FLEET_ACK_REJECTED;
+    }
+  }
+  for (int i = 0; i < d.count; i++) {
+    applySetting(fleetKeyNames[d.entries[i].key], values[i], true);
+  }
+  fleetVersion = d.version;
+  requestConfigSave();
+  Serial.printf("Fleet config version %lu applied (%d settings)\n", (unsigned long)d.version, d.count);
+  return FLEET_ACK_APPLIED;
+}
+
+void handleFleetPacket(const uint8_t *p, size_t len) {
+  fleetStats.packets++;
+  if (!fleetLooksValid(p, len)) {
+    fleetStats.malformed++;
+    return;
+  }
+  if (!fleetSignatureValid(p, len)) {
+    fleetStats.badSignature++;
+    return;
+  }
+  FleetDelta delta;
+  if (!fleetParse(p, len, delta)) {
+    fleetStats.malformed++;
+    return;
+  }
+  FleetAckStatus status = applyFleetDelta(delta);
+  fleetStats.acks[status]++;
+  // The rest of a burst only confirms what its first copy applied
+  if (!(fleetAckPending && fleetAckStatus == FLEET_ACK_APPLIED && status == FLEET_ACK_CURRENT)) {
+    fleetAckStatus = status;
+  }
+  fleetAckIp = fleetUdp.remoteIP();
+  fleetAckPort = fleetUdp.remotePort();
+  if (!fleetAckPending) {
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    fleetAckPending = true;
+    fleetAckDueMs = millis() + ((uint32_t)mac[4] << 8 | mac[5]) % fleetAckSpreadMs;
+  }
+}
+
+void sendFleetAck() {
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  uint8_t ack[fleetAckSize];
+  size_t len = fleetEncodeAck(ack, fleetAckStatus, mac, fleetVersion);
+  fleetUdp.beginPacket(fleetAckIp, fleetAckPort);
+  fleetUdp.write(ack, len);
+  fleetUdp.endPacket();
+}
+
+bool fleetPending() { return fleetKeySet || fleetListening; }
+
+// Planner job: follows the station link, then handles what has arrived
+void serviceFleet() {
+  bool wanted = servicesStarted && fleetKeySet;
+  if (wanted && !fleetListening) {
+    fleetListening = fleetUdp.beginMulticast(fleetGroup, fleetPort);
+    if (fleetListening) {
+      Serial.printf("Fleet: listening on %s:%u\n", fleetGroup.toString().c_str(), fleetPort);
+    }
+  } else if (!wanted && fleetListening) {
+    fleetUdp.stop();
+    fleetListening = false;
+    fleetAckPending = false;
+  }
+  if (!fleetListening) return;
+
+  uint8_t packet[fleetPacketMax];
+  for (int i = 0; i < fleetPacketsPerRun; i++) {
+    int len = fleetUdp.parsePacket();
+    if (len <= 0) break;
+    int n = fleetUdp.read(packet, sizeof(packet));
+    captureFleetPacket(packet, n, len, fleetUdp.remoteIP(), fleetUdp.remotePort());
+    handleFleetPacket(packet, len == n ? (size_t)n : 0); // Oversized counts as malformed
+  }
+  if (fleetAckPending && (long)(millis() - fleetAckDueMs) >= 0) {
+    fleetAckPending = false;
+    sendFleetAck();
+  }
+}
+
+int hexDigitValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  return (c | 0x20) - 'a' + 10;
+}
+
+// The live key only changes once the whole text has decoded
+bool parseFleetKey(const char *hex) {
+  if (strlen(hex) != 2 * fleetKeySize) return false;
+  uint8_t key[fleetKeySize];
+  for (size_t i = 0; i < fleetKeySize; i++) {
+    char hi = hex[2 * i];
+    char lo = hex[2 * i + 1];
+    if (!isxdigit((unsigned char)hi) || !isxdigit((unsigned char)lo)) return false;
+    key[i] = (uint8_t)(hexDigitValue(hi) << 4 | hexDigitValue(lo));
+  }
+  memcpy(fleetKey, key, sizeof(fleetKey));
+  return true;
+}
+
+void printFleetStats() {
+  if (!fleetKeySet) {
+    Serial.printf("Fleet: no key set, config version %lu\n", (unsigned long)fleetVersion);
+    return;
+  }
+  Serial.printf("Fleet: %s %s:%u, config version %lu\n", fleetListening ? "listening on" : "idle,",
+                fleetGroup.toString().c_str(), fleetPort, (unsigned long)fleetVersion);
+  Serial.printf("  packets %lu, malformed %lu, bad signature %lu\n", (unsigned long)fleetStats.packets,
+                (unsigned long)fleetStats.malformed, (unsigned long)fleetStats.badSignature);
+  Serial.print("  acks");
+  for (int i = 0; i < FLEET_ACK_STATUS_COUNT; i++) {
+    Serial.printf(" %s:%lu", fleetAckNames[i], (unsigned long)fleetStats.acks[i]);
+  }
+  Serial.println();
+}
+
+// =================================================================
+// EMISSION BACKEND BENCHMARK
+// =================================================================
+
+// 'emit bench' runs one or all emission backends in turn for the same number
+// of epochs under the same background load, generated by a planner job ten
+// times a second: a /config.json render into the request arena (web
+// traffic without a client), a display frame and, every tenth run, a full
+// settings save to NVS. Per backend it reports cycles per epoch for encode
+// and transmit, heap allocations per epoch and the emission offset (phase
+// of the second when the epoch was handed to the transport) as mean, p99
+// and max. On the host replayer the cycles are nanoseconds of host time.
+
+const uint32_t emitBenchLoadPeriodMs = 100;
+const int emitBenchNvsEvery = 10;      // Load runs per settings save
+
+struct EmitBenchResult {
+  bool valid;
+  uint32_t epochs;
+  uint32_t encodeCycles;               // Means per epoch
+  uint32_t transmitCycles;
+  uint32_t maxEncodeCycles;
+  uint32_t maxTransmitCycles;
+  uint32_t bytes;
+  uint32_t allocsX10;                  // Allocations per epoch, times ten
+  uint32_t drops;
+  uint32_t offsetMeanUs;
+  uint32_t offsetP99Us;
+  uint32_t offsetMaxUs;
+};
+
+struct EmitBench {
+  bool running;
+  bool reportPending;
+  int backend;                         // Being measured
+  int last;
+  int restore;                         // Selected before the run
+  uint32_t epochs;                     // Per backend
+  uint32_t loadRuns;
+};
 
-unsigned long buttonPressStart = 0;
+EmitBench emitBench = {};
+EmitBenchResult emitBenchResults[emissionBackendCount] = {};
 
-// New globals for WiFi retry logic
-unsigned long lastWifiRetry = 0;
-const unsigned long wifiRetryInterval = 30000; // Retry every 30 seconds
-bool servicesStarted = false; // Flag to track if NTP and mDNS are running
+int compareU32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
+}
 
-// =================================================================
-// TIME & STATUS FUNCTIONS
-// =================================================================
+void finishEmitMeasure(EmitBenchResult &r) {
+  EmissionMeasure &m = emitMeasure;
+  m.active = false;
+  r = EmitBenchResult();
+  r.valid = m.epochs > 0;
+  if (!r.valid) return;
+  r.epochs = m.epochs;
+  r.encodeCycles = (uint32_t)(m.encodeCycles / m.epochs);
+  r.transmitCycles = (uint32_t)(m.transmitCycles / m.epochs);
+  r.maxEncodeCycles = m.maxEncodeCycles;
+  r.maxTransmitCycles = m.maxTransmitCycles;
+  r.bytes = m.bytes / m.epochs;
+  r.allocsX10 = m.allocs * 10 / m.epochs;
+  r.drops = m.drops;
+  uint64_t sum = 0;
+  for (uint32_t i = 0; i < m.epochs; i++) sum += m.offsetsUs[i];
+  r.offsetMeanUs = (uint32_t)(sum / m.epochs);
+  // Sorted in place; the samples are not needed any more
+  qsort(m.offsetsUs, m.epochs, sizeof(m.offsetsUs[0]), compareU32);
+  r.offsetP99Us = m.offsetsUs[(m.epochs * 99 + 99) / 100 - 1];
+  r.offsetMaxUs = m.offsetsUs[m.epochs - 1];
+}
 
-void updateTimeStatus() {
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  struct tm *tm_struct = gmtime(&tv.tv_sec);
-  // Consider time "set" if the year is plausible (post-2020)
-  timeSet = (tm_struct->tm_year + 1900) >= 2020;
+void startEmitBench(int first, int last, uint32_t epochs) {
+  emitBench = EmitBench();
+  emitBench.running = true;
+  emitBench.backend = first;
+  emitBench.last = last;
+  emitBench.restore = emissionBackend;
+  emitBench.epochs = epochs;
+  for (int i = first; i <= last; i++) emitBenchResults[i].valid = false;
+  emissionBackend = first;
+  emitMeasureBegin();
 }
 
-// =================================================================
-// CONFIGURATION MANAGEMENT (SAVE/LOAD FROM FLASH)
-// =================================================================
+void printEmitBenchResults() {
+  bool any = false;
+  for (int i = 0; i < emissionBackendCount; i++) any |= emitBenchResults[i].valid;
+  if (!any) return;
+  uint32_t loadPerS = 1000 / emitBenchLoadPeriodMs;
+  Serial.printf("Emission backends under load (%lu page renders, %lu display frames, %lu NVS saves per s)\n",
+                (unsigned long)loadPerS, (unsigned long)loadPerS, (unsigned long)(loadPerS / emitBenchNvsEvery));
+  Serial.println("  backend  epochs  encode cyc (max)     transmit cyc (max)   allocs  bytes  drops"
+                 "  offset us mean/p99/max");
+  for (int i = 0; i < emissionBackendCount; i++) {
+    const EmitBenchResult &r = emitBenchResults[i];
+    if (!r.valid) continue;
+    char allocs[12];
+    FmtBuf a(allocs, sizeof(allocs));
+    if (emitAllocsCounted) {
+      fmtFixed(a, r.allocsX10, 1);
+    } else {
+      fmtStr(a, "n/a");
+    }
+    Serial.printf("  %-7s %7lu %9lu (%7lu) %9lu (%7lu) %7s %6lu %6lu  %lu/%lu/%lu\n", emissionBackends[i].name,
+                  (unsigned long)r.epochs, (unsigned long)r.encodeCycles, (unsigned long)r.maxEncodeCycles,
+                  (unsigned long)r.transmitCycles, (unsigned long)r.maxTransmitCycles, allocs,
+                  (unsigned long)r.bytes, (unsigned long)r.drops, (unsigned long)r.offsetMeanUs,
+                  (unsigned long)r.offsetP99Us, (unsigned long)r.offsetMaxUs);
+  }
+}
 
-void saveConfig() {
-  preferences.putString("ssid", ssid);
-  preferences.putString("password", password);
-  preferences.putString("hostname", hostname);
-  preferences.putString("ntpserver", ntpServer);
-  preferences.putInt("baudrate", baudrate);
-  preferences.putInt("rotation", screenRotation);
+// The benchmark's load: the same for every backend
+void generateEmitLoad() {
+  ArenaWriter json;
+  json.begin();
+  renderConfigJson(json);
+  arenaReset();
+  publishDisplay();
+  if (++emitBench.loadRuns % emitBenchNvsEvery == 0) requestConfigSave();
 }
 
-void loadConfig() {
-  ssid = preferences.getString("ssid", "");
-  password = preferences.getString("password", "");
-  hostname = preferences.getString("hostname", "NixieGPSEmu");
-  ntpServer = preferences.getString("ntpserver", "pool.ntp.org");
-  baudrate = preferences.getInt("baudrate", 9600);
-  screenRotation = preferences.getInt("rotation", 1);
+bool emitBenchPending() { return emitBench.running || emitBench.reportPending; }
+
+// Planner job: generates the load, moves on to the next backend once the
+// current one has its epochs and prints the report at the end
+void serviceEmitBench() {
+  if (emitBench.reportPending) {
+    emitBench.reportPending = false;
+    printEmitBenchResults();
+    return;
+  }
+  generateEmitLoad();
+  if (emitMeasure.epochs < emitBench.epochs) return;
+  finishEmitMeasure(emitBenchResults[emitBench.backend]);
+  if (emitBench.backend < emitBench.last) {
+    emissionBackend = ++emitBench.backend;
+    emitMeasureBegin();
+  } else {
+    emitBench.running = false;
+    emitBench.reportPending = true;
+    emissionBackend = emitBench.restore;
+  }
 }
 
+
 // =================================================================
-// WEB SERVER & CONFIGURATION PORTAL
+// EPOCH PHASE PLANNER
 // =================================================================
 
-void setupWebRoutes() {
-  server.on("/", []() {
-    String html = "<html><head><title>NixieGPS-Emulator</title>"
-                  "<style>"
-                  "body { font-family: Arial, sans-serif; background-color: #222; color: #eee; font-size: 24px; }"
-                  "form { margin: auto; width: 640px; padding: 40px; background: #333; border-radius: 20px; }"
-                  "input, select { width: 100%; margin: 16px 0; padding: 16px; border-radius: 8px; border: none; font-size: 24px; box-sizing: border-box; }"
-                  "input[type=submit] { background-color: #4CAF50; color: white; font-weight: bold; cursor: pointer; padding: 16px; }"
-                  "h2 { text-align: center; font-size: 28px; }"
-                  "</style>"
-                  "</head><body><form method='POST' action='/save'>"
-                  "<h2>NixieGPS-Emulator Configure WiFi and Settings</h2>";
-    html += "SSID: <select name='ssid'>";
-    int n = WiFi.scanNetworks();
-    for (int i = 0; i < n; ++i) {
-      String ssidScan = WiFi.SSID(i);
-      int rssi = WiFi.RSSI(i);
-      html += "<option value='" + ssidScan + "'";
-      // Improvement: Pre-select the currently saved SSID
-      if (ssidScan == ssid) {
-        html += " selected";
-      }
-      html += ">" + ssidScan + " (" + String(rssi) + "dBm)</option>";
-    }
-    html += "</select><br>";
-    html += "Password: <input type='password' name='password' placeholder='Enter new password'><br>";
-    html += "Hostname: <input type='text' name='hostname' value='" + hostname + "'><br>";
-    html += "NTP Server: <input type='text' name='ntpserver' value='" + ntpServer + "'><br>";
-    html += "Baudrate: <input type='number' name='baudrate' value='" + String(baudrate) + "'><br>";
-    html += "Screen Rotation: <select name='rotation'>";
-    html += "<option value='1'";
-    if (screenRotation == 1) html += " selected";
-    html += ">Normal</option>";
-
-    html += "<option value='3'";
-    if (screenRotation == 3) html += " selected";
-    html += ">180 Degrees</option>";
-    html += "</select><br>";
-    html += "<input type='submit' value='Save'>";
-    html += "</form></body></html>";
-    server.send(200, "text/html", html);
-  });
+// Each second is split into phases. The protected window around the second
+// edge belongs to emission alone; the rest of the second is available to
+// background jobs. A job becomes runnable once it is due and the current
+// phase has reached its slot, and it only starts if its budget fits before
+// the next protected window. A job that has waited past its deadline runs
+// in the next free slot regardless of its preferred phase.
+//
+// Per job the planner counts budget overruns and runs that ended inside the
+// protected window (encroachments), so it is visible which subsystem gets in
+// the way of emission.
 
-  server.on("/save", []() {
-    String connectingToSSID = server.hasArg("ssid") ? server.arg("ssid") : ssid;
-    if (server.hasArg("ssid")) ssid = server.arg("ssid");
-    // Only update password if a new one is provided
-    if (server.hasArg("password") && server.arg("password").length() > 0) {
-        password = server.arg("password");
-    }
-    if (server.hasArg("hostname")) hostname = server.arg("hostname");
-    if (server.hasArg("ntpserver")) ntpServer = server.arg("ntpserver");
-    if (server.hasArg("baudrate")) baudrate = server.arg("baudrate").toInt();
-    if (server.hasArg("rotation")) {
-      screenRotation = server.arg("rotation").toInt();
+const uint32_t protectBeforeUs = 20000;  // Protected window before the edge
+const uint32_t protectAfterUs = 30000;   // ... and after it
+
+// Bookkeeping of a job, zero at boot
+struct PlannerJobState {
+  unsigned long dueMs;
+  bool waiting;          // Runnable but not yet run ...
+  unsigned long readyMs; // ... since this time
+  uint32_t runs;
+  uint32_t overruns;
+  uint32_t encroachments;
+  uint32_t deadlineMisses;
+  uint32_t maxUs;
+};
+
+struct PlannerJob {
+  const char *name;
+  Subsystem sub;
+  void (*run)();
+  bool (*pending)();     // NULL: runs every period
+  uint32_t periodMs;     // 0: every free slot
+  uint32_t slotUs;       // Earliest phase within the second
+  uint32_t budgetUs;
+  uint32_t deadlineMs;   // Max wait after becoming runnable
+  PlannerJobState state;
+};
+
+bool nvsPending() {
+  return configSavePending || staChannelSavePending || networkStatsSavePending || driftModelSavePending ||
+         fleetKeySavePending;
+}
+bool logPending() { return gpsLogPending; }
+bool ntpPollPending() { return servicesStarted && millis() - lastNtpStartMs >= ntpPollIntervalMs; }
+
+void ntpPoll() {
+  lastNtpStartMs = millis();
+  ntpExchangeBegin();
+  markNtpRequest();
+  sntp_restart();
+}
+
+void handleHttp() {
+  server.handleClient();
+}
+
+bool consolePending();
+void serviceConsole();
+
+PlannerJob plannerJobs[] = {
+  // name       subsystem      run               pending         period   slot    budget  deadline  state
+  {"display",   SUB_DISPLAY,   publishDisplay,   NULL,           1000,    30000,  2000,   500,      {}},
+  {"http",      SUB_HTTP,      handleHttp,       NULL,           0,       0,      20000,  200,      {}},
+  {"log",       SUB_LOG,       flushGpsLog,      logPending,     0,       100000, 10000,  800,      {}},
+  {"nvs",       SUB_NVS,       flushPendingConfig, nvsPending,   0,       300000, 60000,  5000,     {}},
+  {"wifi-scan", SUB_WIFI_SCAN, serviceWifiScan,  NULL,           1000,    400000, 20000,  5000,     {}},
+  {"ntp",       SUB_NTP,       ntpPoll,          ntpPollPending, 0,       500000, 5000,   60000,    {}},
+  {"clock",     SUB_CLOCK,     serviceClock,     NULL,           1000,    600000, 2000,   1000,     {}},
+  {"fleet",     SUB_FLEET,     serviceFleet,     fleetPending,   100,     0,      5000,   1000,     {}},
+  {"bench",     SUB_BENCH,     serviceEmitBench, emitBenchPending, emitBenchLoadPeriodMs, 0, 10000, 1000, {}},
+  {"console",   SUB_CONSOLE,   serviceConsole,   consolePending, 0,       0,      100000, 1000,     {}},
+};
+const int plannerJobCount = sizeof(plannerJobs) / sizeof(plannerJobs[0]);
+
+uint32_t lastEmitOffsetUs = 0; // Emission time after the second edge
+
+// Phase within the current second of system time
+uint32_t currentPhaseUs(time_t *sec) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  if (sec != NULL) *sec = tv.tv_sec;
+  return tv.tv_usec;
+}
+
+bool inProtectedWindow(uint32_t phaseUs) {
+  return phaseUs < protectAfterUs || phaseUs >= 1000000UL - protectBeforeUs;
+}
+
+bool jobDue(const PlannerJob &job, unsigned long nowMs) {
+  if (job.pending != NULL && !job.pending()) return false;
+  return (long)(nowMs - job.state.dueMs) >= 0;
+}
+
+// Runs at most one background job per loop iteration
+void plannerRunJob() {
+  uint32_t phaseUs = currentPhaseUs(NULL);
+  if (inProtectedWindow(phaseUs)) return;
+  uint32_t slotLeftUs = 1000000UL - protectBeforeUs - phaseUs;
+  unsigned long nowMs = millis();
+
+  // Round-robin from the job after the last one run, so jobs that are always
+  // due (HTTP) cannot starve the others
+  static int nextJob = 0;
+  PlannerJob *chosen = NULL;
+  for (int n = 0; n < plannerJobCount; n++) {
+    int i = (nextJob + n) % plannerJobCount;
+    PlannerJob &job = plannerJobs[i];
+    if (!jobDue(job, nowMs)) continue;
+    bool fits = phaseUs >= job.slotUs && job.budgetUs <= slotLeftUs;
+    PlannerJobState &st = job.state;
+    bool late = st.waiting && nowMs - st.readyMs > job.deadlineMs;
+    if (late) {
+      st.deadlineMisses++;
+    } else if (!fits) {
+      if (!st.waiting) {
+        st.waiting = true;
+        st.readyMs = nowMs;
       }
-    saveConfig();
+      continue;
+    }
+    chosen = &job;
+    nextJob = i + 1;
+    break;
+  }
+  if (chosen == NULL) return;
 
-    // Improvement: More informative save page
-    String response = "<html><head><style>body{font-family: Arial, sans-serif; background-color: #222; color: #eee; font-size: 24px; text-align: center; padding-top: 50px;}</style></head>"
-                      "<body><h2>Settings Saved!</h2>"
-                      "<p>Rebooting and attempting to connect to:</p>"
-                      "<p style='color: #4CAF50; font-weight: bold;'>" + connectingToSSID + "</p>"
-                      "</body></html>";
-    server.send(200, "text/html", response);
+  uint32_t start = micros();
+  {
+    SubsystemScope scope(chosen->sub);
+    chosen->run();
+  }
+  uint32_t elapsed = micros() - start;
+  uint32_t endPhaseUs = currentPhaseUs(NULL);
 
-    delay(3000); // Give browser time to render the page
-    ESP.restart();
-  });
+  PlannerJobState &st = chosen->state;
+  st.runs++;
+  if (elapsed > st.maxUs) st.maxUs = elapsed;
+  if (elapsed > chosen->budgetUs) st.overruns++;
+  if (inProtectedWindow(endPhaseUs) || endPhaseUs < phaseUs) st.encroachments++;
+  st.dueMs = millis() + chosen->periodMs;
+  st.waiting = false;
 }
 
-// =================================================================
-// WIFI MANAGEMENT
-// =================================================================
+// Emits once per second, as close after the edge as the loop allows
+time_t lastEmittedSec = 0;
 
-void startAPMode() {
-  configMode = true;
-  WiFi.softAP("NixieGPS");
-  IPAddress ip = WiFi.softAPIP();
-  Serial.printf("Started AP mode: IP %s\n", ip.toString().c_str());
-  setupWebRoutes();
-  server.begin();
+void plannerEmit() {
+  time_t sec;
+  currentPhaseUs(&sec);
+  if (sec == lastEmittedSec) return;
+  lastEmittedSec = sec;
+  if (synth.active) return;
+  updateTimeStatus();
+  if (!timeSet) return;
+  SubsystemScope scope(SUB_EMIT);
+  lastEmitOffsetUs = currentPhaseUs(NULL);
+  // Once, when time has just been set: the clock job's fields still say invalid
+  if (!nmeaQualityTimeSet) updateNmeaQuality();
+  outputGPS();
 }
 
+void printPlannerStats() {
+  Serial.printf("Protected window: -%lu/+%lu us, last emission +%lu us\n",
+                (unsigned long)protectBeforeUs, (unsigned long)protectAfterUs,
+                (unsigned long)lastEmitOffsetUs);
+  for (int i = 0; i < plannerJobCount; i++) {
+    const PlannerJob &job = plannerJobs[i];
+    const PlannerJobState &st = job.state;
+    Serial.printf("  %-9s runs %lu max %lu us overruns %lu encroach %lu late %lu\n", job.name,
+                  (unsigned long)st.runs, (unsigned long)st.maxUs, (unsigned long)st.overruns,
+                  (unsigned long)st.encroachments, (unsigned long)st.deadlineMisses);
+  }
+}
 
 // =================================================================
-// GPS EMULATION
+// SERIAL CONSOLE
 // =================================================================
 
-String calculateChecksum(const String &sentence) {
-  uint8_t checksum = 0;
-  for (size_t i = 1; i < sentence.length(); i++) {
-    if (sentence[i] == '*') break;
-    checksum ^= sentence[i];
+// A USB-serial command line that never allocates: characters are collected
+// into a fixed line buffer by a low-priority task and tokenized in place.
+// Commands that only read plain counters run in that task; commands that
+// change settings, trigger actions or read the String settings (which loop()
+// reassigns) are handed to the console planner job, which runs them outside
+// the protected window, while the console task waits for them to finish.
+
+const int consoleLineMax = 96;
+const int consoleArgsMax = 6;
+const uint32_t consolePollMs = 20;
+
+struct ConsoleCommand {
+  const char *name;
+  const char *usage;
+  bool deferred; // Run in a planner slot instead of the console task
+  void (*handler)(int argc, char **argv);
+  uint32_t calls;
+  uint32_t totalUs;
+  uint32_t maxUs;
+};
+
+struct ConsoleRequest {
+  ConsoleCommand *cmd;
+  int argc;
+  char **argv;
+};
+
+QueueHandle_t consoleQueue = NULL;
+TaskHandle_t consoleTaskHandle = NULL;
+
+void printIp(const IPAddress &ip) {
+  Serial.printf("%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+}
+
+void cmdHelp(int argc, char **argv);
+
+void cmdStatus(int, char **) {
+  Serial.printf("Mode:     %s\n", configMode ? (ssid != "" ? "AP+STA" : "AP") : "STA");
+  Serial.printf("WiFi:     %s", WiFi.status() == WL_CONNECTED ? "connected " : "disconnected\n");
+  if (WiFi.status() == WL_CONNECTED) {
+    printIp(WiFi.localIP());
+    Serial.printf(" ch %d %d dBm\n", WiFi.channel(), WiFi.RSSI());
   }
-  char cs[3];
-  sprintf(cs, "%02X", checksum);
-  return String(cs);
+  Serial.printf("SSID:     %s\n", ssid.c_str());
+  Serial.printf("Hostname: %s\n", hostname.c_str());
+  Serial.printf("NTP:      %s (%s)\n", ntpServer.c_str(), timeSet ? "OK" : "not synced");
+  TimeQuality q = currentTimeQuality();
+  Serial.printf("Quality:  %s, RMC %c/%c, GGA %u HDOP %u.%u, GSA %u", timeQualityNames[q.level],
+                q.rmcStatus, q.rmcMode, q.ggaQuality, q.hdop10 / 10, q.hdop10 % 10, q.gsaMode);
+  if (ntpEverSynced) {
+    Serial.printf(", error <= %lu us, synced %lu s ago, drift %lu ppb\n", (unsigned long)q.errorUs,
+                  (millis() - ntpLastSyncMs) / 1000, (unsigned long)ntpDriftPpb);
+  } else {
+    Serial.println();
+  }
+  Serial.printf("NMEA:     %s\n", nmeaSetNames[nmeaSet]);
+  Serial.printf("Baudrate: %d\n", baudrate);
+  Serial.printf("Rotation: %d\n", screenRotation);
+  Serial.printf("Uptime:   %lu s, free heap %u\n", millis() / 1000, ESP.getFreeHeap());
 }
 
-void outputGPS() {
-  struct timeval tv;
-  if (gettimeofday(&tv, NULL) != 0) return;
+void cmdMetrics(int, char **);
 
-  time_t now = tv.tv_sec;
-  struct tm *tm_struct = gmtime(&now);
+void cmdStalls(int, char **) {
+  printStallReport();
+  for (int i = 0; i < SUB_COUNT; i++) {
+    Serial.printf("  %-9s loop %lu emit %lu\n", subsystemNames[i],
+                  (unsigned long)loopStalls[i], (unsigned long)lateEmissions[i]);
+  }
+}
 
-  char buffer[80];
-  sprintf(buffer, "GPRMC,%02d%02d%02d.000,A,0000.0000,N,00000.0000,E,0.0,0.0,%02d%02d%02d,,",
-          tm_struct->tm_hour, tm_struct->tm_min, tm_struct->tm_sec,
-          tm_struct->tm_mday, tm_struct->tm_mon + 1, (tm_struct->tm_year + 1900) % 100);
+void cmdSet(int argc, char **argv) {
+  if (argc != 3) {
+    Serial.println("Usage: set hostname|ntp|ntpps|nmea|baud|rotation <value>");
+    return;
+  }
+  const char *error = applySetting(argv[1], argv[2], false);
+  if (error != NULL) {
+    Serial.printf("%s: %s\n", argv[1], error);
+    return;
+  }
+  applySetting(argv[1], argv[2], true);
+  requestConfigSave();
+  Serial.printf("%s = %s (saved)\n", argv[1], argv[2]);
+}
 
-  String sentence = String(buffer);
-  String checksum = calculateChecksum("$" + sentence);
-  String gpsLine = "$" + sentence + "*" + checksum + "\r\n";
+void cmdSynth(int argc, char **argv) {
+  if (argc == 1) {
+    printSyntheticStats();
+    return;
+  }
+  if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+    stopSynthetic();
+    printSyntheticStats();
+    return;
+  }
+  int y, mo, d, h, mi, sec;
+  if (argc < 3 || argc > 5 || sscanf(argv[1], "%d-%d-%d", &y, &mo, &d) != 3 ||
+      sscanf(argv[2], "%d:%d:%d", &h, &mi, &sec) != 3 || mo < 1 || mo > 12 || d < 1 ||
+      d > 31 || h < 0 || h > 23 || mi < 0 || mi > 59 || sec < 0 || sec > 59) {
+    Serial.println("Usage: synth <YYYY-MM-DD> <hh:mm:ss> [sentences/s, 0=max] [step s] | synth stop");
+    return;
+  }
+  uint32_t rate = argc > 3 ? strtoul(argv[3], NULL, 10) : 1;
+  uint32_t step = argc > 4 ? strtoul(argv[4], NULL, 10) : 1;
+  startSynthetic(epochFromCivil(y, mo, d, h, mi, sec), rate, step);
+  Serial.printf("Synthetic time started at %lu sentences/s, %lu s per sentence\n",
+                (unsigned long)rate, (unsigned long)step);
+}
 
-  Serial.print("GPS output: " + gpsLine);
-  Serial2.print(gpsLine);
+void cmdCapture(int argc, char **argv) {
+  if (argc == 2 && strcmp(argv[1], "start") == 0) {
+    captureStart();
+  } else if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+    captureActive = false;
+  } else if (argc == 2 && strcmp(argv[1], "dump") == 0) {
+    if (captureActive) {
+      Serial.println("Stop the capture first");
+      return;
+    }
+    captureDump();
+    return;
+  } else if (argc != 1) {
+    Serial.println("Usage: capture [start|stop|dump]");
+    return;
+  }
+  Serial.printf("Capture %s: %u of %u bytes, %lu dropped\n", captureActive ? "on" : "off",
+                (unsigned)captureUsed, (unsigned)captureBufferSize, (unsigned long)captureDropped);
 }
 
-// =================================================================
-// DISPLAY MANAGEMENT
-// =================================================================
+void cmdNtp(int, char **) {
+  printNtpPsStats();
+}
 
-void drawDisplay() {
-  sprite.fillSprite(TFT_BLACK);
+void cmdNets(int, char **) {
+  for (int i = 0; i < savedNetworkCount; i++) {
+    const NetworkStats &st = savedNetworks[i].stats;
+    Serial.printf("%c%d %-20s %u/%u ok, connect %lu ms, rtt %lu us, score %lu\n",
+                  i == currentNetwork ? '*' : ' ', i, savedNetworks[i].ssid.c_str(),
+                  st.successes, st.attempts, (unsigned long)st.avgConnectMs,
+                  (unsigned long)st.avgNtpRttUs,
+                  (unsigned long)networkScore(st, networkRssi(savedNetworks[i].ssid)));
+  }
+}
 
-  if (configMode) {
-    // AP Mode display
-    sprite.setTextSize(3);
-    sprite.setTextColor(TFT_ORANGE);
-    sprite.setCursor(40, 20);
-    sprite.println("AP Mode");
+void cmdForget(int argc, char **argv) {
+  if (argc != 2 || atoi(argv[1]) < 0 || atoi(argv[1]) >= savedNetworkCount) {
+    Serial.println("Usage: forget <index from 'nets'>");
+    return;
+  }
+  if (forgetNetwork(atoi(argv[1]))) {
+    // Leave the forgotten network and pick the best remaining one
+    WiFi.disconnect();
+    connectToBestNetwork();
+    if (savedNetworkCount == 0) Serial.println("No saved networks left; the setup portal starts after a reboot");
+  }
+  requestConfigSave();
+}
 
-    sprite.setTextSize(2);
-    sprite.setCursor(5, 70);
-    sprite.setTextColor(TFT_WHITE);
-    sprite.print("IP: ");
-    sprite.setTextColor(TFT_CYAN);
-    sprite.println(WiFi.softAPIP().toString());
-  } else if (WiFi.status() != WL_CONNECTED) {
-    // Improvement: New state for Connecting / Reconnecting
-    sprite.setTextSize(3);
-    sprite.setTextColor(TFT_ORANGE);
-    sprite.setCursor(10, 20);
-    sprite.println("Connecting...");
+void cmdResync(int, char **) {
+  if (!servicesStarted) {
+    Serial.println("Not connected");
+    return;
+  }
+  startNtp(); // Restarts SNTP, which polls immediately
+  Serial.println("NTP resync requested");
+}
 
-    sprite.setTextSize(2);
-    sprite.setCursor(5, 70);
-    sprite.setTextColor(TFT_WHITE);
-    sprite.print("SSID: ");
-    sprite.setTextColor(TFT_CYAN);
-    sprite.println(ssid);
+void cmdReboot(int, char **) {
+  Serial.println("Rebooting...");
+  delay(100);
+  ESP.restart();
+}
+
+void cmdTest(int argc, char **argv) {
+  if (argc == 2 && strcmp(argv[1], "bars") == 0) {
+    testPatternUntil = millis() + 5000;
+    publishDisplay();
+  } else if (argc == 2 && strcmp(argv[1], "nmea") == 0) {
+    if (timeSet) {
+      updateNmeaQuality();
+      outputGPS();
+    } else {
+      Serial.println("Time not set");
+    }
+  } else if (argc == 2 && strcmp(argv[1], "off") == 0) {
+    testPatternUntil = millis();
+    publishDisplay();
   } else {
-    // Normal connected display
-    sprite.setTextColor(TFT_WHITE);
-    sprite.setTextSize(2);
-    sprite.setCursor(5, 0);
-    sprite.print("Host: ");
-    sprite.setTextColor(TFT_CYAN);
-    sprite.print(hostname.c_str());
+    Serial.println("Usage: test bars|nmea|off");
+  }
+}
 
-    sprite.setCursor(5, 30);
-    sprite.setTextColor(TFT_WHITE);
-    sprite.print("IP: ");
-    sprite.setTextColor(TFT_CYAN);
-    sprite.print(WiFi.localIP().toString());
+void cmdPlanner(int, char **) {
+  printPlannerStats();
+}
 
-    sprite.setCursor(5, 60);
-    sprite.setTextColor(TFT_WHITE);
-    sprite.print("NTP: ");
-    
-    if (timeSet) {
-      sprite.setTextColor(TFT_GREEN);
-      sprite.print("OK");
+void cmdFleet(int argc, char **argv) {
+  if (argc == 3 && strcmp(argv[1], "key") == 0) {
+    if (strcmp(argv[2], "off") == 0) {
+      fleetKeySet = false;
+    } else if (parseFleetKey(argv[2])) {
+      fleetKeySet = true;
     } else {
-      sprite.setTextColor(TFT_WHITE);
-      sprite.print("Syncing...");
+      Serial.println("The key is 64 hex digits");
+      return;
     }
+    fleetKeySavePending = true;
+  } else if (argc != 1) {
+    Serial.println("Usage: fleet [key <hex>|off]");
+    return;
+  }
+  printFleetStats();
+}
 
-    sprite.setCursor(5, 90);
-    if (timeSet) {
-      struct timeval tv;
-      gettimeofday(&tv, NULL);
-      struct tm *tm_struct = gmtime(&tv.tv_sec);
-      sprite.setTextSize(3);
-      char timebuf[20];
-      sprintf(timebuf, "%02d:%02d:%02d UTC", tm_struct->tm_hour, tm_struct->tm_min, tm_struct->tm_sec);
-      sprite.setTextColor(TFT_CYAN);
-      sprite.print(timebuf);
+void cmdEmit(int argc, char **argv) {
+  if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+    uint32_t seconds = argc > 2 ? strtoul(argv[2], NULL, 10) : 60;
+    const char *which = argc > 3 ? argv[3] : "all";
+    int first = 0;
+    int last = emissionBackendCount - 1;
+    if (strcmp(which, "all") != 0) {
+      first = -1;
+      for (int i = 0; i < emissionBackendCount; i++) {
+        if (strcmp(which, emissionBackends[i].name) == 0) first = i;
+      }
+      last = first;
+    }
+    if (argc > 4 || first < 0 || seconds < 10 || seconds > (uint32_t)emitMeasureMax) {
+      Serial.printf("Usage: emit bench [10-%d s] [backend|all]\n", emitMeasureMax);
+      return;
+    }
+    if (!timeSet || synth.active || emitBench.running) {
+      Serial.println("Needs time set, no synthetic output and no benchmark running");
+      return;
+    }
+    startEmitBench(first, last, seconds);
+    Serial.printf("Benchmarking %d backend(s) for %lu epochs each\n", last - first + 1, (unsigned long)seconds);
+    return;
+  }
+  if (argc == 2) {
+    int idx = -1;
+    for (int i = 0; i < emissionBackendCount; i++) {
+      if (strcmp(argv[1], emissionBackends[i].name) == 0) idx = i;
+    }
+    if (idx < 0 || !emissionBackends[idx].reachesWire || emitBench.running) {
+      Serial.println("Usage: emit [fast|legacy] | emit bench [seconds] [backend|all]");
+      return;
+    }
+    emissionBackend = idx;
+  } else if (argc != 1) {
+    Serial.println("Usage: emit [fast|legacy] | emit bench [seconds] [backend|all]");
+    return;
+  }
+  for (int i = 0; i < emissionBackendCount; i++) {
+    Serial.printf("%c %s%s\n", i == emissionBackend ? '*' : ' ', emissionBackends[i].name,
+                  emissionBackends[i].reachesWire ? "" : " (benchmark only)");
+  }
+  printEmitBenchResults();
+}
+
+void cmdClock(int, char **) {
+  printClockStats();
+}
+
+void cmdDisplay(int, char **) {
+  printDisplayStats();
+}
+
+void cmdUart(int, char **) {
+  printUartStats(gpsUart);
+}
+
+// Cycle counts for the formatting hot paths, newlib sprintf vs FastFormat
+void cmdBench(int, char **) {
+  const int iterations = 1000;
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  time_t now = tv.tv_sec;
+  struct tm tm_copy = *gmtime(&now);
+  char buf[96];
+  volatile size_t sink = 0;
+  // A copy: this runs in the console task while loop() emits from nmeaQuality
+  NmeaQualityFields quality;
+  renderNmeaQuality(quality, currentTimeQuality());
+
+  uint32_t start = ESP.getCycleCount();
+  for (int i = 0; i < iterations; i++) {
+    int n = sprintf(buf, "$GPRMC,%02d%02d%02d.000,%c,0000.0000,N,00000.0000,E,0.0,0.0,%02d%02d%02d,,,%c",
+                    tm_copy.tm_hour, tm_copy.tm_min, tm_copy.tm_sec, quality.quality.rmcStatus,
+                    tm_copy.tm_mday, tm_copy.tm_mon + 1, (tm_copy.tm_year + 1900) % 100,
+                    quality.quality.rmcMode);
+    n += sprintf(buf + n, "*%02X\r\n", calculateChecksum(buf));
+    sink += n;
+  }
+  uint32_t sprintfCycles = (ESP.getCycleCount() - start) / iterations;
+
+  start = ESP.getCycleCount();
+  for (int i = 0; i < iterations; i++) {
+    sink += formatRMC(buf, sizeof(buf), &tm_copy, quality);
+  }
+  uint32_t fastCycles = (ESP.getCycleCount() - start) / iterations;
+
+  Serial.printf("RMC sentence: sprintf %lu cycles, FastFormat %lu cycles\n",
+                (unsigned long)sprintfCycles, (unsigned long)fastCycles);
+  (void)sink;
+}
+
+ConsoleCommand consoleCommands[] = {
+  {"help",    "",                      false, cmdHelp,    0, 0, 0},
+  {"status",  "",                      true,  cmdStatus,  0, 0, 0},
+  {"metrics", "",                      false, cmdMetrics, 0, 0, 0},
+  {"stalls",  "",                      false, cmdStalls,  0, 0, 0},
+  {"set",     "<key> <value>",         true,  cmdSet,     0, 0, 0},
+  {"nets",    "",                      true,  cmdNets,    0, 0, 0},
+  {"ntp",     "",                      false, cmdNtp,     0, 0, 0},
+  {"capture", "[start|stop|dump]",     false, cmdCapture, 0, 0, 0},
+  {"synth",   "<date> <time> [rate] [step]|stop", true, cmdSynth, 0, 0, 0},
+  {"forget",  "<index>",               true,  cmdForget,  0, 0, 0},
+  {"resync",  "",                      true,  cmdResync,  0, 0, 0},
+  {"reboot",  "",                      true,  cmdReboot,  0, 0, 0},
+  {"test",    "bars|nmea|off",         true,  cmdTest,    0, 0, 0},
+  {"bench",   "",                      false, cmdBench,   0, 0, 0},
+  {"uart",    "",                      false, cmdUart,    0, 0, 0},
+  {"display", "",                      false, cmdDisplay, 0, 0, 0},
+  {"clock",   "",                      false, cmdClock,   0, 0, 0},
+  {"fleet",   "[key <hex>|off]",       true,  cmdFleet,   0, 0, 0},
+  {"emit",    "[backend]|bench [s] [backend|all]", true, cmdEmit, 0, 0, 0},
+  {"planner", "",                      false, cmdPlanner, 0, 0, 0},
+};
+const int consoleCommandCount = sizeof(consoleCommands) / sizeof(consoleCommands[0]);
+
+void cmdHelp(int, char **) {
+  for (int i = 0; i < consoleCommandCount; i++) {
+    Serial.printf("  %-8s %s\n", consoleCommands[i].name, consoleCommands[i].usage);
+  }
+}
+
+void cmdMetrics(int, char **) {
+  Serial.printf("Heap: free %u, min free %u, largest block %u\n", ESP.getFreeHeap(),
+                ESP.getMinFreeHeap(), ESP.getMaxAllocHeap());
+  for (int i = 0; i < ROUTE_COUNT; i++) {
+    Serial.printf("Arena %-8s peak %u of %u\n", webRouteNames[i],
+                  (unsigned)arenaPeak[i], (unsigned)requestArenaSize);
+  }
+  for (int i = 0; i < consoleCommandCount; i++) {
+    const ConsoleCommand &c = consoleCommands[i];
+    if (c.calls == 0) continue;
+    Serial.printf("Cmd %-8s calls %lu avg %lu us max %lu us\n", c.name, (unsigned long)c.calls,
+                  (unsigned long)(c.totalUs / c.calls), (unsigned long)c.maxUs);
+  }
+}
+
+void runConsoleCommand(ConsoleCommand *cmd, int argc, char **argv) {
+  uint32_t start = micros();
+  cmd->handler(argc, argv);
+  uint32_t elapsed = micros() - start;
+  cmd->calls++;
+  cmd->totalUs += elapsed;
+  if (elapsed > cmd->maxUs) cmd->maxUs = elapsed;
+}
+
+void dispatchConsoleLine(char *line) {
+  char *argv[consoleArgsMax];
+  int argc = 0;
+  char *p = line;
+  while (*p != '\0' && argc < consoleArgsMax) {
+    while (*p == ' ' || *p == '\t') *p++ = '\0';
+    if (*p == '\0') break;
+    argv[argc++] = p;
+    while (*p != '\0' && *p != ' ' && *p != '\t') p++;
+  }
+  if (argc == 0) return;
+
+  for (int i = 0; i < consoleCommandCount; i++) {
+    ConsoleCommand *cmd = &consoleCommands[i];
+    if (strcmp(argv[0], cmd->name) != 0) continue;
+    if (cmd->deferred) {
+      // argv points into the console task's line buffer, which stays
+      // untouched until the planner job signals completion.
+      ConsoleRequest req = {cmd, argc, argv};
+      xQueueSend(consoleQueue, &req, portMAX_DELAY);
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
     } else {
-      sprite.setTextSize(2);
-      sprite.setTextColor(TFT_CYAN);
-      sprite.print("Waiting for NTP...");
+      runConsoleCommand(cmd, argc, argv);
     }
+    return;
   }
-  sprite.pushSprite(0, 0);
+  Serial.printf("Unknown command: %s (try 'help')\n", argv[0]);
+}
+
+void consoleTask(void *) {
+  char line[consoleLineMax];
+  int len = 0;
+  bool overflow = false;
+  for (;;) {
+    while (Serial.available() > 0) {
+      int c = Serial.read();
+      if (c == '\r' || c == '\n') {
+        if (overflow) {
+          Serial.println("Line too long");
+        } else if (len > 0) {
+          line[len] = '\0';
+          dispatchConsoleLine(line);
+        }
+        len = 0;
+        overflow = false;
+      } else if (c == '\b' || c == 0x7F) {
+        if (len > 0) len--;
+      } else if (len < consoleLineMax - 1) {
+        line[len++] = (char)c;
+      } else {
+        overflow = true;
+      }
+    }
+    vTaskDelay(pdMS_TO_TICKS(consolePollMs));
+  }
+}
+
+void startConsole() {
+  consoleQueue = xQueueCreate(1, sizeof(ConsoleRequest));
+  // Core 0 at priority 1: below the WiFi/lwIP tasks and never competing with
+  // the loop task on core 1.
+  xTaskCreatePinnedToCore(consoleTask, "console", 4096, NULL, 1, &consoleTaskHandle, 0);
 }
 
+bool consolePending() {
+  return consoleQueue != NULL && uxQueueMessagesWaiting(consoleQueue) > 0;
+}
+
+// The console planner job: runs the waiting deferred command. Serial output
+// blocks once the UART FIFO is full, so the budget covers a full 'status'
+// at 115200 baud.
+void serviceConsole() {
+  ConsoleRequest req;
+  if (consoleQueue != NULL && xQueueReceive(consoleQueue, &req, 0) == pdTRUE) {
+    runConsoleCommand(req.cmd, req.argc, req.argv);
+    xTaskNotifyGive(consoleTaskHandle);
+  }
+}
 
 // =================================================================
 // MAIN SETUP & LOOP
@@ -309,10 +3438,14 @@ void drawDisplay() {
 
 void setup() {
   Serial.begin(115200);
+  printStallReport();
   preferences.begin("config", false);
   loadConfig();
+  loadDriftModel();
+  updateNmeaQuality();
+  mountAssets();
 
-  Serial2.begin(baudrate, SERIAL_8N1, -1, GPS_TX_PIN);
+  gpsUartBegin(baudrate);
 
   pinMode(RESET_BUTTON_PIN, INPUT_PULLUP);
   delay(50); // Small delay to stabilize pin reading
@@ -322,7 +3455,7 @@ tft.setRotation(screenRotation);
 
 sprite.createSprite(tft.width(), tft.height());
 sprite.setRotation(screenRotation);
-
+  startDisplay();
 
   // Improvement: Force AP mode if no SSID saved OR reset button is held on boot
   if (ssid == "" || digitalRead(RESET_BUTTON_PIN) == LOW) {
@@ -331,16 +3464,20 @@ sprite.setRotation(screenRotation);
   } else {
     configMode = false;
     WiFi.mode(WIFI_STA);
-    WiFi.begin(ssid.c_str(), password.c_str());
-    Serial.printf("Attempting to connect to saved WiFi: %s\n", ssid.c_str());
+    connectToBestNetwork();
     setupWebRoutes();
     server.begin();
   }
+
+  WiFi.onEvent(captureWifiEvent);
+  startMdns();
+  startConsole();
 }
 
 void checkResetButton() {
   if (digitalRead(RESET_BUTTON_PIN) == LOW) {
     if (!buttonPressed) {
+      captureButton(true);
       buttonPressed = true;
       buttonPressStart = millis();
     } else if (millis() - buttonPressStart >= 2000) {
@@ -350,64 +3487,25 @@ void checkResetButton() {
       ESP.restart();
     }
   } else {
+    if (buttonPressed) captureButton(false);
     buttonPressed = false;
   }
 }
 
 void loop() {
-  server.handleClient();
+  stallMonitorLoopStart();
+  plannerEmit();
+  serviceSynthetic();
   checkResetButton();
 
-  if (configMode) {
-    // In AP mode, just update the display periodically
-    unsigned long now = millis();
-    if (now - lastDisplayUpdate > displayInterval) {
-      lastDisplayUpdate = now;
-      drawDisplay();
-    }
-  } else { // Normal (Station) Mode
-    if (WiFi.status() != WL_CONNECTED) {
-      // We are disconnected
-      if (servicesStarted) {
-        Serial.println("WiFi connection lost.");
-        MDNS.end();
-        servicesStarted = false; // Reset flag to re-init services on reconnect
-        timeSet = false; // Time is no longer reliable
-      }
-      // Improvement: Non-blocking periodic retry
-      unsigned long now = millis();
-      if (now - lastWifiRetry > wifiRetryInterval) {
-        lastWifiRetry = now;
-        Serial.println("Retrying WiFi connection...");
-        WiFi.begin(ssid.c_str(), password.c_str());
-      }
-    } else {
-      // We are connected
-      if (!servicesStarted) {
-        // This block runs once upon successful connection
-        Serial.printf("WiFi Connected! IP: %s\n", WiFi.localIP().toString().c_str());
-        configTime(0, 0, ntpServer.c_str());
-        
-        if (MDNS.begin(hostname.c_str())) {
-          Serial.printf("mDNS responder started: http://%s.local\n", hostname.c_str());
-        } else {
-          Serial.println("Error starting mDNS");
-        }
-        servicesStarted = true;
-      }
-    }
-
-    // This section runs continuously in normal mode
-    unsigned long now = millis();
-    if (now - lastDisplayUpdate > displayInterval) {
-      lastDisplayUpdate = now;
-      drawDisplay(); // The display function is now connection-aware
-      if (WiFi.status() == WL_CONNECTED) {
-        updateTimeStatus();
-        if (timeSet) {
-          outputGPS();
-        }
-      }
-    }
+  // The station link runs in normal mode and, concurrently with the softAP,
+  // in config mode whenever a network has been saved.
+  if (ssid != "") {
+    SubsystemScope scope(SUB_WIFI);
+    maintainStationLink();
   }
+
+  // Display, HTTP, logging, NVS, scans, NTP polls and console commands run
+  // in planner slots
+  plannerRunJob();
 }
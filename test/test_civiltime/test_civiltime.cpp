@@ -0,0 +1,86 @@
+/**
+ * test_civiltime.cpp
+ *
+ * CivilTime.h against the host's 64-bit gmtime_r() for every day from 1875
+ * to 2223 (the range the synthetic time generator is used with), at a
+ * different time of day each day.
+ *
+ * Run with: pio test -e native
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include <unity.h>
+
+#include "CivilTime.h"
+
+const int64_t firstDay = -34698;  // 1875-01-01
+const int64_t lastDay = 92770;    // 2223-12-31
+
+void setUp() {}
+void tearDown() {}
+
+void assertSameFields(int64_t secs) {
+  time_t t = (time_t)secs;
+  struct tm want = {};
+  struct tm got = {};
+  TEST_ASSERT_NOT_NULL(gmtime_r(&t, &want));
+  civilFromEpoch(secs, got);
+  char msg[48];
+  snprintf(msg, sizeof(msg), "at %lld", (long long)secs);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(want.tm_year, got.tm_year, msg);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(want.tm_mon, got.tm_mon, msg);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(want.tm_mday, got.tm_mday, msg);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(want.tm_hour, got.tm_hour, msg);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(want.tm_min, got.tm_min, msg);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(want.tm_sec, got.tm_sec, msg);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(want.tm_wday, got.tm_wday, msg);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(want.tm_yday, got.tm_yday, msg);
+}
+
+void test_civil_from_epoch_matches_gmtime() {
+  TEST_ASSERT_EQUAL_INT(8, sizeof(time_t));
+  for (int64_t day = firstDay; day <= lastDay; day++) {
+    int64_t secondOfDay = ((day * 7919) % 86400 + 86400) % 86400;
+    assertSameFields(day * 86400 + secondOfDay);
+  }
+}
+
+void test_day_edges() {
+  for (int64_t day = firstDay; day <= lastDay; day += 97) {
+    assertSameFields(day * 86400);
+    assertSameFields(day * 86400 - 1);
+  }
+}
+
+void test_epoch_from_civil_round_trips() {
+  for (int64_t day = firstDay; day <= lastDay; day++) {
+    int64_t secs = day * 86400 + 45296;  // 12:34:56
+    struct tm t = {};
+    civilFromEpoch(secs, t);
+    TEST_ASSERT_EQUAL_INT64(secs, epochFromCivil(t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour,
+                                                 t.tm_min, t.tm_sec));
+  }
+}
+
+// The dates 'synth' is meant to exercise
+void test_known_dates() {
+  TEST_ASSERT_EQUAL_INT64(0, epochFromCivil(1970, 1, 1, 0, 0, 0));
+  TEST_ASSERT_EQUAL_INT64(951782400, epochFromCivil(2000, 2, 29, 0, 0, 0));
+  TEST_ASSERT_EQUAL_INT64(2147483648LL, epochFromCivil(2038, 1, 19, 3, 14, 8));
+  TEST_ASSERT_EQUAL_INT64(4102444800LL, epochFromCivil(2100, 1, 1, 0, 0, 0));
+  struct tm t = {};
+  civilFromEpoch(epochFromCivil(2100, 2, 28, 23, 59, 59) + 1, t);
+  TEST_ASSERT_EQUAL_INT(2, t.tm_mon);  // 2100 is not a leap year
+  TEST_ASSERT_EQUAL_INT(1, t.tm_mday);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_civil_from_epoch_matches_gmtime);
+  RUN_TEST(test_day_edges);
+  RUN_TEST(test_epoch_from_civil_round_trips);
+  RUN_TEST(test_known_dates);
+  return UNITY_END();
+}
@@ -0,0 +1,153 @@
+/**
+ * test_fastformat.cpp
+ *
+ * Each FastFormat.h helper against the snprintf() format it replaces, over
+ * digit-count boundaries, widths, negative values and the fixed-point
+ * degree/minute fields of the NMEA sentences, plus truncation on a full
+ * buffer.
+ *
+ * Run with: pio test -e native
+ */
+
+#include <limits.h>
+#include <stdio.h>
+
+#include <unity.h>
+
+#include "FastFormat.h"
+
+// Values around every change in digit count, and the extremes
+const uint32_t uintSamples[] = {
+  0, 1, 9, 10, 11, 99, 100, 101, 999, 1000, 9999, 10000, 99999, 100000, 999999, 1000000,
+  9999999, 10000000, 99999999, 100000000, 999999999, 1000000000, 4294967294u, 4294967295u,
+};
+const int32_t intSamples[] = {
+  0, 1, -1, 9, -9, 10, -10, 99, -99, 100, -100, 12345, -12345, 999999, -999999,
+  2147483647, -2147483647, INT32_MIN,
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_fmt2() {
+  for (unsigned v = 0; v < 300; v++) {
+    char want[8];
+    char got[8];
+    snprintf(want, sizeof(want), "%02u", v % 100);
+    FmtBuf b(got, sizeof(got));
+    fmt2(b, v);
+    TEST_ASSERT_EQUAL_STRING(want, got);
+  }
+}
+
+void test_fmt_uint() {
+  for (uint32_t v : uintSamples) {
+    for (int width = 0; width <= 12; width++) {
+      char want[24];
+      char got[24];
+      snprintf(want, sizeof(want), "%0*lu", width, (unsigned long)v);
+      FmtBuf b(got, sizeof(got));
+      fmtUint(b, v, width);
+      TEST_ASSERT_EQUAL_STRING_MESSAGE(want, got, want);
+      TEST_ASSERT_EQUAL_size_t(strlen(want), b.length());
+    }
+  }
+}
+
+void test_fmt_int() {
+  for (int32_t v : intSamples) {
+    for (int width = 0; width <= 13; width++) {
+      char want[24];
+      char got[24];
+      snprintf(want, sizeof(want), "%0*ld", width, (long)v);
+      FmtBuf b(got, sizeof(got));
+      fmtInt(b, v, width);
+      TEST_ASSERT_EQUAL_STRING_MESSAGE(want, got, want);
+    }
+  }
+}
+
+// fmtFixed(scaled, decimals, intWidth) is "%0*.*f" of scaled / 10^decimals
+// with the width counting the integer digits only
+void assertFixed(int32_t scaled, int decimals, int intWidth) {
+  double div = 1;
+  for (int i = 0; i < decimals; i++) div *= 10;
+  int width = intWidth + (decimals > 0 ? decimals + 1 : 0) + (scaled < 0 ? 1 : 0);
+  char want[32];
+  char got[32];
+  snprintf(want, sizeof(want), "%0*.*f", width, decimals, scaled / div);
+  FmtBuf b(got, sizeof(got));
+  fmtFixed(b, scaled, decimals, intWidth);
+  TEST_ASSERT_EQUAL_STRING_MESSAGE(want, got, want);
+}
+
+void test_fmt_fixed() {
+  for (int32_t v : intSamples) {
+    for (int decimals = 0; decimals <= 6; decimals++) {
+      for (int intWidth = 0; intWidth <= 5; intWidth++) assertFixed(v, decimals, intWidth);
+    }
+  }
+  assertFixed(-5, 1, 0);   // "-0.5"
+  assertFixed(5, 3, 0);    // "0.005"
+  assertFixed(18, 1, 0);   // HDOP "1.8"
+}
+
+// Latitude ddmm.mmmm and longitude dddmm.mmmm, in 1e-4 minutes, as in RMC/GGA
+void test_fmt_fixed_degrees() {
+  const int32_t minutes[] = {
+    0,          // 0000.0000
+    1,          // 0000.0001
+    5999,       // 0000.5999
+    48070380,   // 4807.0380
+    89599999,   // 8959.9999
+    179599999,  // 17959.9999
+  };
+  for (int32_t m : minutes) {
+    assertFixed(m, 4, 4);
+    assertFixed(m, 4, 5);
+  }
+}
+
+void test_fmt_hex2() {
+  for (unsigned v = 0; v < 256; v++) {
+    char want[4];
+    char got[4];
+    snprintf(want, sizeof(want), "%02X", v);
+    FmtBuf b(got, sizeof(got));
+    fmtHex2(b, (uint8_t)v);
+    TEST_ASSERT_EQUAL_STRING(want, got);
+  }
+}
+
+// A full buffer keeps what fits, like snprintf, and flags the overflow
+void test_truncation() {
+  for (size_t size = 1; size <= 12; size++) {
+    char want[16];
+    char got[16];
+    snprintf(want, size, "$GPRMC,%lu*%02X", 123519UL, 0x6Au);
+    FmtBuf b(got, size);
+    fmtStr(b, "$GPRMC,");
+    fmtUint(b, 123519);
+    fmtChar(b, '*');
+    fmtHex2(b, 0x6A);
+    TEST_ASSERT_EQUAL_STRING(want, got);
+    TEST_ASSERT_TRUE(b.overflow);
+  }
+  char buf[32];
+  FmtBuf b(buf, sizeof(buf));
+  fmtStr(b, "$GPRMC,");
+  fmtUint(b, 123519);
+  TEST_ASSERT_FALSE(b.overflow);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fmt2);
+  RUN_TEST(test_fmt_uint);
+  RUN_TEST(test_fmt_int);
+  RUN_TEST(test_fmt_fixed);
+  RUN_TEST(test_fmt_fixed_degrees);
+  RUN_TEST(test_fmt_hex2);
+  RUN_TEST(test_truncation);
+  return UNITY_END();
+}
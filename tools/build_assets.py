@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Builds the web asset image for the "assets" flash partition.
+
+Every file under the source directory (default: web/) is gzip-compressed and
+packed into one image using the layout in include/AssetImage.h. The image is
+flashed separately from the firmware, for example:
+
+    python tools/build_assets.py -o assets.bin
+    esptool.py --chip esp32 write_flash 0x290000 assets.bin
+
+The offset is that of the "assets" partition in partitions.csv.
+"""
+
+import argparse
+import gzip
+import mimetypes
+import os
+import struct
+import sys
+
+MAGIC = 0x3141584E  # "NXA1"
+VERSION = 1
+PATH_MAX = 40
+MIME_MAX = 24
+FLAG_GZIP = 0x01
+HEADER = struct.Struct("<IHHII")
+ENTRY = struct.Struct("<%ds%dsIII" % (PATH_MAX, MIME_MAX))
+PARTITION_SIZE = 0x160000
+
+MIME_TYPES = {
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+}
+
+
+def collect(src):
+    files = []
+    for root, _, names in os.walk(src):
+        for name in sorted(names):
+            full = os.path.join(root, name)
+            url = "/" + os.path.relpath(full, src).replace(os.sep, "/")
+            files.append((url, full))
+    return sorted(files)
+
+
+def build(src):
+    files = collect(src)
+    data_start = HEADER.size + ENTRY.size * len(files)
+    entries = []
+    blobs = []
+    offset = data_start
+    for url, full in files:
+        ext = os.path.splitext(full)[1].lower()
+        mime = MIME_TYPES.get(ext) or mimetypes.guess_type(full)[0] or "application/octet-stream"
+        if len(url) >= PATH_MAX or len(mime) >= MIME_MAX:
+            sys.exit("path or MIME type too long: %s (%s)" % (url, mime))
+        with open(full, "rb") as f:
+            raw = f.read()
+        # mtime=0 keeps the image reproducible
+        packed = gzip.compress(raw, compresslevel=9, mtime=0)
+        flags = FLAG_GZIP
+        if len(packed) >= len(raw):
+            packed, flags = raw, 0
+        entries.append(ENTRY.pack(url.encode(), mime.encode(), offset, len(packed), flags))
+        pad = (-len(packed)) % 4
+        blobs.append(packed + b"\0" * pad)
+        offset += len(packed) + pad
+        print("%-24s %-24s %6d -> %6d bytes" % (url, mime, len(raw), len(packed)))
+    header = HEADER.pack(MAGIC, VERSION, len(files), offset, 0)
+    return header + b"".join(entries) + b"".join(blobs)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", nargs="?", default="web", help="directory with the web files")
+    parser.add_argument("-o", "--output", default="assets.bin", help="image file to write")
+    args = parser.parse_args()
+
+    image = build(args.source)
+    if len(image) > PARTITION_SIZE:
+        sys.exit("image is %d bytes, partition holds %d" % (len(image), PARTITION_SIZE))
+    with open(args.output, "wb") as f:
+        f.write(image)
+    print("wrote %s: %d bytes" % (args.output, len(image)))
+
+
+if __name__ == "__main__":
+    main()
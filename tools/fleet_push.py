@@ -0,0 +1,229 @@
+#!/usr/bin/env python3
+"""Pushes a signed settings delta to every unit on the fleet multicast group.
+
+The delta is packed and signed as described in include/FleetConfig.h, sent a
+few times to cover packet loss, and the units' acknowledgements are collected
+and summarised. Each unit needs the fleet key first ('fleet key <hex>' on its
+serial console). For example, to move the whole fleet from version 2 to 3:
+
+    python tools/fleet_push.py -k fleet.key -v 3 ntp=time.example.net baud=4800
+
+A delta must hold every change made since its base version (-b, default the
+version before -v). Units that answer "gap" are older than the base; push the
+cumulative delta again from an earlier base.
+
+With --simulate N the push goes to N instances of the host replayer
+(tools/replay) on a loopback multicast group instead, each with its own MAC,
+and their 'status' and 'fleet' output is checked afterwards:
+
+    g++ -std=gnu++17 -O1 -Itools/replay/shim -Iinclude tools/replay/replay.cpp -o replay
+    python tools/fleet_push.py --simulate 8 -k fleet.key -v 1 ntp=time.example.net
+"""
+
+import argparse
+import hashlib
+import hmac
+import os
+import re
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+FORMAT = 1
+HEADER = struct.Struct("<4sBBII")
+ACK = struct.Struct("<4sBB6sI")
+KEYS = {"ntp": 1, "baud": 2, "nmea": 3, "ntpps": 4, "rotation": 5}
+ACK_NAMES = ["applied", "current", "gap", "rejected"]
+VALUE_MAX = 63
+ENTRIES_MAX = 8
+PACKET_MAX = 512
+
+# Input trace records (include/InputTrace.h) that bring a host instance online
+INPUT_WIFI_UP = 1
+INPUT_NTP_SAMPLE = 3
+
+
+def load_key(arg):
+    text = arg
+    if os.path.exists(arg):
+        with open(arg) as f:
+            text = f.read()
+    text = text.strip()
+    if not re.fullmatch(r"[0-9a-fA-F]{64}", text):
+        sys.exit("the fleet key is 64 hex digits")
+    return bytes.fromhex(text)
+
+
+def build_packet(key, version, base, settings):
+    if len(settings) > ENTRIES_MAX:
+        sys.exit("at most %d settings per push" % ENTRIES_MAX)
+    body = b""
+    for name, value in settings:
+        raw = value.encode()
+        if not 0 < len(raw) <= VALUE_MAX:
+            sys.exit("%s: value must be 1 to %d bytes" % (name, VALUE_MAX))
+        body += bytes([KEYS[name], len(raw)]) + raw
+    signed = HEADER.pack(b"NGFC", FORMAT, len(settings), version, base) + body
+    packet = signed + hmac.new(key, signed, hashlib.sha256).digest()
+    if len(packet) > PACKET_MAX:
+        sys.exit("packet is %d bytes, units accept %d" % (len(packet), PACKET_MAX))
+    return packet
+
+
+def parse_setting(text):
+    name, sep, value = text.partition("=")
+    if not sep or name not in KEYS:
+        raise argparse.ArgumentTypeError("expected key=value with key one of %s" % ", ".join(KEYS))
+    return name, value
+
+
+def push(packet, group, port, iface, repeat, interval, wait):
+    """Sends the burst and returns {mac: (status, version)} from the acks."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_LOOP, 1)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton(iface))
+    sock.bind(("", 0))
+    for i in range(repeat):
+        if i:
+            time.sleep(interval)
+        sock.sendto(packet, (group, port))
+    acks = {}
+    deadline = time.monotonic() + wait
+    while True:
+        left = deadline - time.monotonic()
+        if left <= 0:
+            break
+        sock.settimeout(left)
+        try:
+            data, _ = sock.recvfrom(64)
+        except socket.timeout:
+            break
+        if len(data) != ACK.size:
+            continue
+        magic, status, fmt, mac, version = ACK.unpack(data)
+        if magic != b"NGFA" or fmt != FORMAT or status >= len(ACK_NAMES):
+            continue
+        unit = ":".join("%02x" % b for b in mac)
+        # Later copies of the burst are answered with "current"
+        if acks.get(unit) != ("applied", version):
+            acks[unit] = (ACK_NAMES[status], version)
+    sock.close()
+    return acks
+
+
+def report(acks):
+    for mac in sorted(acks):
+        status, version = acks[mac]
+        print("  %s  %-8s version %d" % (mac, status, version))
+    counts = {}
+    for status, _ in acks.values():
+        counts[status] = counts.get(status, 0) + 1
+    print("%d units answered: %s" % (len(acks), ", ".join(
+        "%d %s" % (counts[s], s) for s in ACK_NAMES if s in counts) or "none"))
+
+
+def write_trace(path):
+    """Link up at once, then an NTP step to the host's time 100 ms later."""
+    now_us = int(time.time() * 1e6)
+    records = [
+        struct.pack("<BBI", INPUT_WIFI_UP, 6, 0) + bytes([6, 256 - 50, 127, 0, 0, 1]),
+        struct.pack("<BBIIq", INPUT_NTP_SAMPLE, 12, 100, 20000, now_us),
+    ]
+    with open(path, "wb") as f:
+        f.write(b"".join(records))
+
+
+def simulate(args, key, packet):
+    replay = os.path.abspath(args.replay)
+    if not os.access(replay, os.X_OK):
+        sys.exit("no replayer at %s (see tools/replay/replay.cpp to build it)" % replay)
+    run_s = 2 + args.repeat * args.interval + args.wait + 1
+    with tempfile.TemporaryDirectory() as tmp:
+        trace = os.path.join(tmp, "online.trace")
+        write_trace(trace)
+        procs = []
+        for i in range(args.simulate):
+            mac = "02:00:00:00:%02x:%02x" % (i >> 8, i & 0xFF)
+            cmd = [replay, "-w", "-q", "-t", "%d" % run_s, "-m", mac, "-k", key.hex(),
+                   "-c", "status", "-c", "fleet", trace]
+            procs.append((mac, subprocess.Popen(cmd, stdout=subprocess.PIPE, text=True)))
+        time.sleep(2)  # Boot, link up and join the group
+        acks = push(packet, args.group, args.port, "127.0.0.1", args.repeat, args.interval, args.wait)
+        report(acks)
+        failures = 0
+        for mac, proc in procs:
+            out, _ = proc.communicate(timeout=run_s + 30)
+            problems = check_instance(out, args)
+            if mac not in acks:
+                problems.append("no ack")
+            if problems:
+                failures += 1
+                print("  %s: %s" % (mac, "; ".join(problems)))
+        print("%d of %d instances have version %d and its settings" % (
+            len(procs) - failures, len(procs), args.version))
+        return failures == 0
+
+
+def check_instance(out, args):
+    # How the 'status' command shows each setting ('ntpps' is not shown)
+    shown = {
+        "ntp": r"^NTP:\s+(\S+)",
+        "baud": r"^Baudrate: (\d+)",
+        "nmea": r"^NMEA:\s+(\S+)",
+        "rotation": r"^Rotation: (\d+)",
+    }
+    problems = []
+    m = re.search(r"config version (\d+)", out)
+    if not m or int(m.group(1)) != args.version:
+        problems.append("config version %s" % (m.group(1) if m else "missing"))
+    for name, value in args.settings:
+        if name not in shown:
+            continue
+        m = re.search(shown[name], out, re.M)
+        if not m or m.group(1) != value:
+            problems.append("%s is %s" % (name, m.group(1) if m else "missing"))
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("settings", nargs="+", type=parse_setting, metavar="key=value",
+                        help="settings to change: %s" % ", ".join(KEYS))
+    parser.add_argument("-k", "--key", required=True, help="fleet key: 64 hex digits or a file holding them")
+    parser.add_argument("-v", "--version", type=int, required=True, help="version the delta brings units to")
+    parser.add_argument("-b", "--base", type=int, help="oldest version the delta applies to")
+    parser.add_argument("--group", default="239.255.71.80", help="multicast group")
+    parser.add_argument("--port", type=int, default=7147)
+    parser.add_argument("--iface", default="0.0.0.0", help="address of the interface to send from")
+    parser.add_argument("--repeat", type=int, default=3, help="copies of the packet to send")
+    parser.add_argument("--interval", type=float, default=0.1, help="seconds between copies")
+    parser.add_argument("--wait", type=float, default=2.0, help="seconds to collect acks")
+    parser.add_argument("--expect", type=int, help="exit non-zero unless this many units are up to date")
+    parser.add_argument("--simulate", type=int, metavar="N", help="push to N host instances on loopback")
+    parser.add_argument("--replay", default="./replay", help="host replayer binary for --simulate")
+    args = parser.parse_args()
+
+    base = args.version - 1 if args.base is None else args.base
+    if not 0 <= base < args.version < 2 ** 31:
+        sys.exit("need 0 <= base < version")
+    key = load_key(args.key)
+    packet = build_packet(key, args.version, base, args.settings)
+    print("version %d from base %d: %d settings, %d bytes" % (args.version, base, len(args.settings),
+                                                            len(packet)))
+
+    if args.simulate:
+        sys.exit(0 if simulate(args, key, packet) else 1)
+
+    acks = push(packet, args.group, args.port, args.iface, args.repeat, args.interval, args.wait)
+    report(acks)
+    current = sum(1 for status, _ in acks.values() if status in ("applied", "current"))
+    if args.expect is not None and current < args.expect:
+        sys.exit("%d of %d expected units are up to date" % (current, args.expect))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,204 @@
+/**
+ * holdover_sim.cpp
+ *
+ * Host simulation of the temperature-compensated holdover (DriftModel.h)
+ * against synthetic thermal profiles. A crystal with an AT-cut style
+ * frequency-vs-temperature curve follows the room temperature through a
+ * thermal lag; the chip's sensor reads a self-heated, noisy, quantised die
+ * temperature. The clock is synced over NTP once an hour for a few days and
+ * then runs through a WiFi outage. Three strategies are compared on the
+ * same noise sequence:
+ *
+ *   none    no correction between syncs
+ *   single  one drift rate, learned from the last sync interval
+ *   model   the binned temperature model, as in the firmware
+ *
+ * "online rms" is the error just before each sync from the second day on,
+ * i.e. how well time is held between syncs. For the model strategy the
+ * firmware's time-quality bound at the end of the outage is printed next to
+ * the real error.
+ *
+ * Build (from the repository root):
+ *   g++ -std=gnu++17 -O2 -Iinclude tools/holdover_sim/holdover_sim.cpp -o holdover_sim
+ *
+ * Usage:
+ *   holdover_sim [learn-days] [outage-hours] [seed]     (default 4 24 1)
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <random>
+
+#include "DriftModel.h"
+#include "TimeQuality.h"
+
+namespace {
+
+const double pi = 3.14159265358979;
+const int syncIntervalS = 3600;       // Planner NTP poll period
+const double syncNoiseUs = 2000;      // Path asymmetry, one sigma
+const double crystalLagS = 600;       // Crystal follows the room
+const double dieLagS = 300;           // Die sensor follows the room
+const double selfHeatingC = 22;       // Die above room temperature
+const double sensorNoiseC = 0.8;
+const double sensorStepC = 0.55;      // Resolution of the ESP32 internal sensor
+const double chipSmoothing = 0.125;   // Same as the firmware
+
+enum Strategy { NONE, SINGLE, MODEL, STRATEGY_COUNT };
+const char *const strategyNames[STRATEGY_COUNT] = {"none", "single", "model"};
+
+struct Profile {
+  const char *name;
+  double (*roomC)(double t, double outageStartS);
+};
+
+double dailyRoom(double t, double) {
+  return 21 + 4 * sin(2 * pi * t / 86400);
+}
+
+// Thermostat cycling between 19 and 23 C every 40 minutes on top of the day
+double hvacRoom(double t, double) {
+  double cycle = fmod(t, 2400) / 2400;
+  double saw = cycle < 0.5 ? cycle * 2 : 2 - cycle * 2;
+  return 19 + 4 * saw + 1.5 * sin(2 * pi * t / 86400);
+}
+
+// Sun on the shelf for three hours every afternoon
+double sunlitRoom(double t, double) {
+  double h = fmod(t, 86400) / 3600;
+  double sun = (h >= 13 && h < 16) ? 10 * sin(pi * (h - 13) / 3) : 0;
+  return 20 + 2 * sin(2 * pi * t / 86400) + sun;
+}
+
+// Steady room, then a cold snap as the outage starts (worst case for a
+// drift rate learned at one temperature)
+double coldSnapRoom(double t, double outageStartS) {
+  if (t < outageStartS) return 22 + 0.5 * sin(2 * pi * t / 86400);
+  return 14 + 8 * exp(-(t - outageStartS) / 3600);
+}
+
+const Profile profiles[] = {
+  {"daily", dailyRoom},
+  {"hvac", hvacRoom},
+  {"sunlit", sunlitRoom},
+  {"coldsnap", coldSnapRoom},
+};
+
+// Frequency error in ppm (positive: the clock runs fast)
+double crystalPpm(double tempC) {
+  double d = tempC - 25;
+  return 3.0 - 0.12 * d + 0.00018 * d * d * d;
+}
+
+struct Result {
+  double onlineRmsUs;     // Error just before each sync, after the first day
+  double outageEndUs;
+  double outageMaxUs;
+  uint32_t boundUs;       // Time-quality bound at the end of the outage
+};
+
+Result run(const Profile &p, Strategy strategy, int learnDays, int outageHours, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> gauss(0, 1);
+
+  const double outageStartS = learnDays * 86400.0;
+  const double endS = outageStartS + outageHours * 3600.0;
+
+  DriftModel model = {};
+  DriftInterval interval = {};
+  double crystalC = p.roomC(0, outageStartS);
+  double dieC = crystalC + selfHeatingC;
+  double chipC = dieC;
+  double errUs = 0;          // Local minus true
+  double singlePpb = 0;      // SINGLE: correction applied
+  double intervalS = 0;
+  int32_t lastResidualPpb = 0;
+  double lastSyncS = 0;
+  Result r = {};
+  double onlineSumSq = 0;
+  int onlineCount = 0;
+
+  for (double t = 1; t <= endS; t += 1) {
+    double room = p.roomC(t, outageStartS);
+    crystalC += (room - crystalC) / crystalLagS;
+    dieC += (room + selfHeatingC - dieC) / dieLagS;
+    double reading = dieC + sensorNoiseC * gauss(rng);
+    reading = sensorStepC * floor(reading / sensorStepC + 0.5);
+    chipC += (reading - chipC) * chipSmoothing;
+
+    int32_t correctionPpb = 0;
+    if (strategy == SINGLE) {
+      correctionPpb = (int32_t)singlePpb;
+    } else if (strategy == MODEL) {
+      if (!driftModelLookup(model, (float)chipC, correctionPpb)) correctionPpb = 0;
+    }
+    errUs += crystalPpm(crystalC) + correctionPpb / 1000.0;
+    driftIntervalAdd(interval, (float)chipC, 1000, (int64_t)correctionPpb);
+    intervalS += 1;
+
+    bool online = t < outageStartS;
+    if (online && fmod(t, syncIntervalS) == 0) {
+      if (t > 86400) {
+        onlineSumSq += errUs * errUs;
+        onlineCount++;
+      }
+      double measuredUs = -errUs + syncNoiseUs * gauss(rng);
+      int64_t correctionUs = (int64_t)measuredUs;
+      if (strategy == SINGLE) singlePpb += measuredUs * 1000 / intervalS;
+      if (strategy == MODEL) lastResidualPpb = driftModelLearn(model, interval, correctionUs);
+      errUs += measuredUs;
+      driftIntervalReset(interval);
+      intervalS = 0;
+      lastSyncS = t;
+    }
+    if (!online && fabs(errUs) > r.outageMaxUs) r.outageMaxUs = fabs(errUs);
+  }
+  r.outageEndUs = fabs(errUs);
+  r.onlineRmsUs = onlineCount ? sqrt(onlineSumSq / onlineCount) : 0;
+
+  // What the firmware would report at the end of the outage
+  uint32_t modelPpb = 0;
+  int32_t unused;
+  driftModelLookup(model, (float)chipC, unused, &modelPpb);
+  uint32_t residualPpb = (uint32_t)abs(lastResidualPpb);
+  TimeQualityInput in = {};
+  in.source = TIME_SOURCE_NTP;
+  in.syncAgeS = (uint32_t)(endS - lastSyncS);
+  in.rttUs = (uint32_t)(2 * syncNoiseUs);
+  in.driftPpb = modelPpb > residualPpb ? modelPpb : residualPpb;
+  r.boundUs = timeQualityErrorUs(in);
+  return r;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int learnDays = argc > 1 ? atoi(argv[1]) : 4;
+  int outageHours = argc > 2 ? atoi(argv[2]) : 24;
+  unsigned seed = argc > 3 ? (unsigned)atoi(argv[3]) : 1;
+  if (learnDays < 1 || outageHours < 1) {
+    fprintf(stderr, "usage: holdover_sim [learn-days] [outage-hours] [seed]\n");
+    return 2;
+  }
+
+  printf("%d days of hourly NTP, then a %d h outage (errors in ms)\n\n", learnDays, outageHours);
+  printf("%-9s %-7s %12s %12s %12s %12s\n", "profile", "method", "online rms", "outage max",
+         "outage end", "bound");
+  for (const Profile &p : profiles) {
+    double noneMaxUs = 0;
+    for (int s = 0; s < STRATEGY_COUNT; s++) {
+      Result r = run(p, (Strategy)s, learnDays, outageHours, seed);
+      if (s == NONE) noneMaxUs = r.outageMaxUs;
+      printf("%-9s %-7s %12.1f %12.1f %12.1f", p.name, strategyNames[s], r.onlineRmsUs / 1000,
+             r.outageMaxUs / 1000, r.outageEndUs / 1000);
+      if (s == MODEL) {
+        printf(" %12.1f  (%.1fx better than none)", r.boundUs / 1000.0,
+               r.outageMaxUs > 0 ? noneMaxUs / r.outageMaxUs : 0.0);
+      }
+      printf("\n");
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""Checks the epoch phase planner on an idle unit in the host replayer.
+
+An idle unit (link up, one NTP sync, then nothing) must run every background
+job in its slot: no deadline misses, overruns or encroachments on the
+protected window in the 'planner' report.
+
+    g++ -std=gnu++17 -O1 -Itools/replay/shim -Iinclude tools/replay/replay.cpp -o replay
+    python tools/replay/check_planner.py
+"""
+
+import argparse
+import os
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+# Input trace records (include/InputTrace.h)
+INPUT_WIFI_UP = 1
+INPUT_NTP_SAMPLE = 3
+
+JOB = re.compile(r"^\s+(\S+)\s+runs (\d+) max \d+ us overruns (\d+) encroach (\d+) late (\d+)$", re.M)
+
+
+def write_trace(path):
+    """Link up at once, then an NTP step to the host's time 100 ms later."""
+    now_us = int(time.time() * 1e6)
+    records = [
+        struct.pack("<BBI", INPUT_WIFI_UP, 6, 0) + bytes([6, 256 - 50, 127, 0, 0, 1]),
+        struct.pack("<BBIIq", INPUT_NTP_SAMPLE, 12, 100, 20000, now_us),
+    ]
+    with open(path, "wb") as f:
+        f.write(b"".join(records))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--replay", default="./replay", help="host replayer binary")
+    parser.add_argument("--seconds", type=int, default=120, help="idle time to run")
+    args = parser.parse_args()
+
+    replay = os.path.abspath(args.replay)
+    if not os.access(replay, os.X_OK):
+        sys.exit("no replayer at %s (see tools/replay/replay.cpp to build it)" % replay)
+    with tempfile.TemporaryDirectory() as tmp:
+        trace = os.path.join(tmp, "idle.trace")
+        write_trace(trace)
+        out = subprocess.run([replay, "-q", "-t", str(args.seconds), "-c", "planner", trace],
+                             stdout=subprocess.PIPE, text=True, check=True).stdout
+
+    jobs = JOB.findall(out)
+    if not jobs:
+        sys.exit("no planner report in the replayer's output")
+    problems = []
+    for name, runs, overruns, encroach, late in jobs:
+        for what, count in (("overruns", overruns), ("encroachments", encroach), ("late", late)):
+            if int(count):
+                problems.append("%s: %s %s" % (name, count, what))
+    for problem in problems:
+        print("  " + problem)
+    print("%d jobs, %s" % (len(jobs), "%d problems" % len(problems) if problems else "all on time"))
+    sys.exit(1 if problems else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,408 @@
+/**
+ * replay.cpp
+ *
+ * Host replayer for input traces captured on the device with
+ * 'capture start' / 'capture stop' / 'capture dump' (format in
+ * include/InputTrace.h). The firmware itself (src/main.cpp) is compiled
+ * against the shims in tools/replay/shim and driven on a virtual clock:
+ * setup() runs once, then loop() every loopStepUs, and each recorded input
+ * is injected when the virtual clock reaches its timestamp. Firmware Serial
+ * output and the NMEA sentences written to the GPS UART are printed as they
+ * happen, so a field problem can be stepped through on the host.
+ *
+ * Build (from the repository root):
+ *   g++ -std=gnu++17 -O1 -Itools/replay/shim -Iinclude tools/replay/replay.cpp -o replay
+ *
+ * Usage:
+ *   replay [options] <trace>
+ *     <trace>       a serial log containing the 'capture dump' output, or the
+ *                   raw binary trace
+ *     -s <ssid>     saved network to boot with (default "replay")
+ *     -t <seconds>  keep running after the last input (default 5)
+ *     -c <command>  console command to run after the replay; repeatable
+ *     -r            capture again during the replay and dump the trace at the
+ *                   end, to compare against the input
+ *     -q            only print NMEA sentences
+ *     -w            pace the virtual clock to the wall clock, for live
+ *                   network input such as fleet pushes (tools/fleet_push.py)
+ *     -m <mac>      station MAC, aa:bb:cc:dd:ee:ff (default 02:00:00:00:00:01)
+ *     -k <hex>      fleet key to boot with
+ *
+ * 'emit bench' runs the emission benchmark in virtual time: offsets show
+ * how the planner places emission under load, cycles are host nanoseconds
+ * and allocations are counted through operator new. The replayer keeps
+ * going until the benchmark has reported.
+ *
+ * tools/replay/check_planner.py runs an idle unit and fails if any planner
+ * job missed its deadline or ran into the protected window.
+ *
+ * Inputs are replayed relative to the first one, which is injected one
+ * second after boot. Tasks other than loop() do not run: the console is
+ * driven with -c, and the UART monitor's bookkeeping and the display task's
+ * rendering are done here between loop() iterations.
+ */
+
+// Heap allocations are counted by the operator new below. GCC takes the
+// free() in the matching operator delete for a mismatched deallocation.
+#define EMIT_BENCH_ALLOCS_EXTERNAL
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+#include "../../src/main.cpp"
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <thread>
+
+void *operator new(size_t size) {
+  noteEmitAlloc();
+  void *p = malloc(size ? size : 1);
+  if (p == NULL) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+namespace {
+
+const int64_t loopStepUs = 500;
+const uint32_t firstInputMs = 1000;
+
+struct Input {
+  uint8_t type;
+  uint32_t ms;
+  std::vector<uint8_t> payload;
+};
+
+int hexNibble(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// Collects the bytes of every "TRACE <hex>" line; returns false if the text
+// has none, in which case the file is taken to be a raw trace.
+bool parseTraceLog(const std::string &text, std::vector<uint8_t> &out) {
+  bool found = false;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t eol = text.find('\n', pos);
+    if (eol == std::string::npos) eol = text.size();
+    std::string line = text.substr(pos, eol - pos);
+    pos = eol + 1;
+    size_t at = line.find("TRACE ");
+    if (at == std::string::npos) continue;
+    std::string hex = line.substr(at + 6);
+    if (hex.compare(0, 5, "BEGIN") == 0 || hex.compare(0, 3, "END") == 0) {
+      found = true;
+      continue;
+    }
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+      int hi = hexNibble(hex[i]);
+      int lo = hexNibble(hex[i + 1]);
+      if (hi < 0 || lo < 0) break;
+      out.push_back((uint8_t)(hi << 4 | lo));
+    }
+  }
+  return found;
+}
+
+bool splitRecords(const std::vector<uint8_t> &raw, std::vector<Input> &inputs) {
+  size_t off = 0;
+  while (off + inputRecordHeaderSize <= raw.size()) {
+    Input in;
+    in.type = raw[off];
+    uint8_t len = raw[off + 1];
+    in.ms = 0;
+    for (int i = 0; i < 4; i++) in.ms |= (uint32_t)raw[off + 2 + i] << (8 * i);
+    if (off + inputRecordHeaderSize + len > raw.size()) break;
+    in.payload.assign(raw.begin() + off + inputRecordHeaderSize,
+                      raw.begin() + off + inputRecordHeaderSize + len);
+    inputs.push_back(in);
+    off += inputRecordHeaderSize + len;
+  }
+  if (off != raw.size()) {
+    fprintf(stderr, "replay: trace truncated at byte %zu of %zu\n", off, raw.size());
+    return false;
+  }
+  return true;
+}
+
+uint32_t readU32(const uint8_t *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+void note(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+bool quiet = false;
+
+void note(const char *fmt, ...) {
+  if (quiet) return;
+  char buf[256];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  printf("[replay %lld.%03lld] %s\n", (long long)(hostSim.nowUs / 1000000),
+         (long long)(hostSim.nowUs / 1000 % 1000), buf);
+}
+
+void raiseWifiEvent(arduino_event_id_t id, const arduino_event_info_t &info) {
+  for (WiFiEventSysCb cb : WiFi.handlers) cb(id, info);
+}
+
+// Reproduces the recorded sample exactly: the request is back-dated by the
+// round-trip time and the system clock is stepped by the correction before
+// the SNTP callback sees the new time.
+void injectNtpSample(uint32_t rttUs, int64_t correctionUs) {
+  ntpRequestMonoUs = hostSim.nowUs - rttUs;
+  ntpRequestSysUs = systemTimeUs() - rttUs;
+  hostSim.systemOffsetUs += correctionUs;
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  if (hostSntpCallback != NULL) {
+    hostSntpCallback(&tv);
+  } else {
+    onNtpSync(&tv);
+  }
+}
+
+std::vector<uint8_t> fleetPacket; // Collects a push split over several records
+
+void inject(const Input &in) {
+  const uint8_t *p = in.payload.data();
+  size_t len = in.payload.size();
+  switch (in.type) {
+  case INPUT_WIFI_UP: {
+    if (len < 6) break;
+    WiFi.linkStatus = WL_CONNECTED;
+    WiFi.linkChannel = p[0];
+    WiFi.linkRssi = (int8_t)p[1];
+    WiFi.linkIp = IPAddress(p[2], p[3], p[4], p[5]);
+    note("wifi up: channel %u, rssi %d, ip %s", p[0], (int8_t)p[1], WiFi.linkIp.toString().c_str());
+    arduino_event_info_t info = {};
+    memcpy(&info.got_ip.ip_info.ip.addr, p + 2, 4);
+    raiseWifiEvent(ARDUINO_EVENT_WIFI_STA_GOT_IP, info);
+    break;
+  }
+  case INPUT_WIFI_DOWN: {
+    WiFi.linkStatus = WL_DISCONNECTED;
+    note("wifi down: reason %u", len > 0 ? p[0] : 0);
+    arduino_event_info_t info = {};
+    info.wifi_sta_disconnected.reason = len > 0 ? p[0] : 0;
+    raiseWifiEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, info);
+    break;
+  }
+  case INPUT_NTP_SAMPLE: {
+    if (len < 12) break;
+    uint32_t rttUs = readU32(p);
+    int64_t correctionUs = (int64_t)((uint64_t)readU32(p + 4) | (uint64_t)readU32(p + 8) << 32);
+    note("ntp sample: rtt %lu us, correction %lld us", (unsigned long)rttUs, (long long)correctionUs);
+    injectNtpSample(rttUs, correctionUs);
+    break;
+  }
+  case INPUT_HTTP: {
+    if (len < 1) break;
+    std::string request((const char *)p + 1, len - 1);
+    HTTPMethod method = p[0] == 2 ? HTTP_POST : HTTP_GET;
+    note("http %s %s", method == HTTP_POST ? "POST" : "GET", request.c_str());
+    server.queueRequest(method, request);
+    break;
+  }
+  case INPUT_BUTTON:
+    if (len < 1) break;
+    note("button %s", p[0] == 0 ? "pressed" : "released");
+    hostSim.pinLevel[RESET_BUTTON_PIN] = p[0] == 0 ? LOW : HIGH;
+    break;
+  case INPUT_SCAN: {
+    if (len < 1) break;
+    WiFi.scanResults.clear();
+    size_t off = 1;
+    for (int i = 0; i < p[0] && off + 3 <= len; i++) {
+      HostScanResult r;
+      r.rssi = (int8_t)p[off];
+      r.channel = p[off + 1];
+      size_t ssidLen = p[off + 2];
+      off += 3;
+      if (off + ssidLen > len) break;
+      r.ssid = String(std::string((const char *)p + off, ssidLen));
+      off += ssidLen;
+      WiFi.scanResults.push_back(r);
+    }
+    WiFi.scanReady = true;
+    note("scan: %u networks", (unsigned)WiFi.scanResults.size());
+    break;
+  }
+  case INPUT_FLEET: {
+    if (len < inputFleetHeaderSize) break;
+    fleetPacket.insert(fleetPacket.end(), p + inputFleetHeaderSize, p + len);
+    if (p[0] != 0) break;
+    IPAddress ip(p[1], p[2], p[3], p[4]);
+    uint16_t port = (uint16_t)(p[5] | p[6] << 8);
+    uint16_t received = (uint16_t)(p[7] | p[8] << 8);
+    note("fleet push: %u bytes from %s:%u", received, ip.toString().c_str(), port);
+    fleetUdp.injectPacket(ip, port, received, fleetPacket);
+    fleetPacket.clear();
+    break;
+  }
+  default:
+    note("unknown input type %u skipped", in.type);
+    break;
+  }
+}
+
+// What gpsUartMonitorTask does on the device, minus the polling: a burst is
+// complete once the virtual line has gone idle.
+void serviceUartMonitor() {
+  UartTxStats &st = uartTxStats[gpsUart];
+  HostQueue *q = gpsTxBurstQueue;
+  while (q != NULL && !q->empty() && gpsUartIdle()) {
+    TxBurst burst;
+    xQueueReceive(q, &burst, 0);
+    uint32_t doneUs = (uint32_t)hostUart[gpsUart].busyUntilUs;
+    uint32_t firstByteUs = burst.firstByteUs != 0 ? burst.firstByteUs : burst.enqueuedUs;
+    if ((int32_t)(st.lastDoneUs - firstByteUs) > 0) firstByteUs = st.lastDoneUs;
+    st.bytesDone += burst.len;
+    st.lastEnqueueUs = burst.enqueuedUs;
+    st.lastFirstByteUs = firstByteUs;
+    st.lastDoneUs = doneUs;
+    st.lastStartLatencyUs = firstByteUs - burst.enqueuedUs;
+    st.lastTxTimeUs = doneUs - burst.enqueuedUs;
+    if (st.lastTxTimeUs > st.maxTxTimeUs) st.maxTxTimeUs = st.lastTxTimeUs;
+  }
+}
+
+bool paced = false;
+std::chrono::steady_clock::time_point pacedStart;
+
+// Returns false once the firmware asks for a restart
+bool step() {
+  loop();
+  serviceUartMonitor();
+  displayRenderNext(0);
+  hostSim.nowUs += loopStepUs;
+  // Serial output moves the clock by odd amounts, so pace by elapsed time
+  static int64_t pacedUs = 0;
+  if (paced && hostSim.nowUs - pacedUs >= 10000) {
+    pacedUs = hostSim.nowUs;
+    std::this_thread::sleep_until(pacedStart + std::chrono::microseconds(hostSim.nowUs));
+  }
+  if (hostSim.restartRequested) {
+    note("firmware requested a restart, stopping");
+    return false;
+  }
+  return true;
+}
+
+void usage() {
+  fprintf(stderr, "usage: replay [-s ssid] [-t seconds] [-c command]... [-r] [-q] [-w] [-m mac] [-k key] <trace>\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const char *tracePath = NULL;
+  const char *bootSsid = "replay";
+  int tailSeconds = 5;
+  bool record = false;
+  const char *fleetKeyHex = NULL;
+  std::vector<std::string> commands;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "-s" && i + 1 < argc) {
+      bootSsid = argv[++i];
+    } else if (a == "-t" && i + 1 < argc) {
+      tailSeconds = atoi(argv[++i]);
+    } else if (a == "-c" && i + 1 < argc) {
+      commands.push_back(argv[++i]);
+    } else if (a == "-r") {
+      record = true;
+    } else if (a == "-q") {
+      quiet = true;
+    } else if (a == "-w") {
+      paced = true;
+    } else if (a == "-m" && i + 1 < argc) {
+      unsigned m[6];
+      if (sscanf(argv[++i], "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6) {
+        usage();
+        return 2;
+      }
+      for (int b = 0; b < 6; b++) WiFi.mac[b] = (uint8_t)m[b];
+    } else if (a == "-k" && i + 1 < argc) {
+      fleetKeyHex = argv[++i];
+    } else if (a[0] != '-' && tracePath == NULL) {
+      tracePath = argv[i];
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (tracePath == NULL) {
+    usage();
+    return 2;
+  }
+
+  std::ifstream file(tracePath, std::ios::binary);
+  if (!file) {
+    fprintf(stderr, "replay: cannot open %s\n", tracePath);
+    return 1;
+  }
+  std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  std::vector<uint8_t> raw;
+  if (!parseTraceLog(text, raw)) raw.assign(text.begin(), text.end());
+  std::vector<Input> inputs;
+  if (!splitRecords(raw, inputs)) return 1;
+
+  hostSim.echoSerial = !quiet;
+  hostSim.pinLevel[RESET_BUTTON_PIN] = HIGH;
+  pacedStart = std::chrono::steady_clock::now();
+  preferences.putString("ssid", bootSsid);
+  if (fleetKeyHex != NULL) {
+    if (!parseFleetKey(fleetKeyHex)) {
+      fprintf(stderr, "replay: the fleet key is 64 hex digits\n");
+      return 2;
+    }
+    preferences.putBytes("fleetkey", fleetKey, sizeof(fleetKey));
+  }
+  setup();
+  if (record) captureStart();
+  note("%zu inputs from %s", inputs.size(), tracePath);
+
+  uint32_t baseMs = inputs.empty() ? 0 : inputs[0].ms;
+  size_t next = 0;
+  bool running = true;
+  while (running && next < inputs.size()) {
+    int64_t dueUs = (int64_t)(inputs[next].ms - baseMs + firstInputMs) * 1000;
+    while (running && hostSim.nowUs < dueUs) running = step();
+    if (running) inject(inputs[next++]);
+  }
+  int64_t endUs = hostSim.nowUs + (int64_t)tailSeconds * 1000000;
+  while (running && hostSim.nowUs < endUs) running = step();
+
+  // Deferred commands keep pointers into the console's line and argv, so,
+  // as on the device, the console waits while loop() runs them.
+  hostSim.echoSerial = true;
+  hostSim.notifyWait = [] {
+    while (uxQueueMessagesWaiting(consoleQueue) > 0) step();
+  };
+  for (std::string &cmd : commands) {
+    std::vector<char> line(cmd.begin(), cmd.end());
+    line.push_back('\0');
+    dispatchConsoleLine(line.data());
+  }
+  while (running && emitBenchPending()) running = step();
+  if (record) {
+    captureActive = false;
+    captureDump();
+  }
+  return 0;
+}
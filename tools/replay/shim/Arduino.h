@@ -0,0 +1,294 @@
+/**
+ * Host shim for the parts of the Arduino-ESP32 core the firmware uses.
+ *
+ * Time is virtual: hostSim.nowUs only moves when the replayer advances it,
+ * so a replay is deterministic. The system clock (gettimeofday) is the
+ * virtual uptime plus hostSim.systemOffsetUs, which SNTP syncs change.
+ * FreeRTOS tasks are registered but never run; the replayer performs their
+ * work between loop() iterations.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct HostSim {
+  int64_t nowUs = 0;            // Virtual uptime
+  int64_t systemOffsetUs = 0;   // System time = uptime + offset
+  int pinLevel[40] = {};
+  std::deque<char> serialIn;
+  bool restartRequested = false;
+  bool echoSerial = true;
+  std::function<void()> notifyWait;  // Runs loop() while a task waits for it
+};
+
+inline HostSim hostSim;
+
+inline unsigned long millis() { return (unsigned long)(hostSim.nowUs / 1000); }
+inline unsigned long micros() { return (unsigned long)hostSim.nowUs; }
+inline int64_t esp_timer_get_time() { return hostSim.nowUs; }
+inline void delay(uint32_t ms) { hostSim.nowUs += (int64_t)ms * 1000; }
+
+inline int hostGettimeofday(struct timeval *tv, void *) {
+  int64_t us = hostSim.nowUs + hostSim.systemOffsetUs;
+  tv->tv_sec = (time_t)(us / 1000000);
+  tv->tv_usec = (suseconds_t)(us % 1000000);
+  return 0;
+}
+#define gettimeofday hostGettimeofday
+
+// Slews complete instantly on the host
+inline int hostAdjtime(const struct timeval *delta, struct timeval *olddelta) {
+  if (olddelta != NULL) {
+    olddelta->tv_sec = 0;
+    olddelta->tv_usec = 0;
+  }
+  if (delta != NULL) hostSim.systemOffsetUs += (int64_t)delta->tv_sec * 1000000 + delta->tv_usec;
+  return 0;
+}
+#define adjtime hostAdjtime
+
+#define RTC_NOINIT_ATTR
+#define INPUT_PULLUP 0x05
+#define LOW 0
+#define HIGH 1
+
+inline void pinMode(int, int) {}
+inline int digitalRead(int pin) { return hostSim.pinLevel[pin]; }
+
+inline float hostTempC = 45.0f;
+inline float temperatureRead() { return hostTempC; }
+
+#if !defined(__GLIBC__) || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)
+inline size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t len = strlen(src);
+  if (size) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+#endif
+
+// ---------------------------------------------------------------- String
+
+class String {
+public:
+  String() {}
+  String(const char *s) : s_(s ? s : "") {}
+  String(const std::string &s) : s_(s) {}
+  String(int v) : s_(std::to_string(v)) {}
+  String(long v) : s_(std::to_string(v)) {}
+  String(unsigned v) : s_(std::to_string(v)) {}
+  String(unsigned long v) : s_(std::to_string(v)) {}
+
+  const char *c_str() const { return s_.c_str(); }
+  unsigned length() const { return (unsigned)s_.size(); }
+  long toInt() const { return atol(s_.c_str()); }
+  char operator[](unsigned i) const { return i < s_.size() ? s_[i] : '\0'; }
+
+  bool operator==(const String &o) const { return s_ == o.s_; }
+  bool operator==(const char *o) const { return s_ == (o ? o : ""); }
+  bool operator!=(const String &o) const { return s_ != o.s_; }
+  bool operator!=(const char *o) const { return !(*this == o); }
+  String &operator+=(const String &o) { s_ += o.s_; return *this; }
+  String &operator+=(const char *o) { s_ += o; return *this; }
+  friend String operator+(const String &a, const String &b) { return String(a.s_ + b.s_); }
+  friend String operator+(const char *a, const String &b) { return String(std::string(a) + b.s_); }
+  friend String operator+(const String &a, const char *b) { return String(a.s_ + b); }
+
+private:
+  std::string s_;
+};
+
+inline bool operator==(const char *a, const String &b) { return b == a; }
+
+// ---------------------------------------------------------------- Print / Serial
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual void write(const char *s, size_t n) = 0;
+
+  void print(const char *s) { write(s, strlen(s)); }
+  void print(const String &s) { print(s.c_str()); }
+  void print(char c) { write(&c, 1); }
+  void print(int v) { printf("%d", v); }
+  void print(unsigned v) { printf("%u", v); }
+  void print(long v) { printf("%ld", v); }
+  void print(unsigned long v) { printf("%lu", v); }
+  void println() { print("\n"); }
+  template <typename T> void println(const T &v) { print(v); println(); }
+
+  int printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    write(buf, n < (int)sizeof(buf) ? n : sizeof(buf) - 1);
+    return n;
+  }
+};
+
+// Output costs virtual time as on the device, where Serial has no TX ring:
+// a write returns once all but the last FIFO's worth has been sent, so
+// command handling and logging show their real cost in the reports.
+class HostSerial : public Print {
+public:
+  static const int fifoLen = 128;
+  unsigned long baud = 115200;
+  int64_t busyUntilUs = 0;
+
+  void begin(unsigned long b) { baud = b; }
+  int available() { return (int)hostSim.serialIn.size(); }
+  int read() {
+    if (hostSim.serialIn.empty()) return -1;
+    char c = hostSim.serialIn.front();
+    hostSim.serialIn.pop_front();
+    return (uint8_t)c;
+  }
+  void write(const char *s, size_t n) override {
+    if (hostSim.echoSerial) fwrite(s, 1, n, stdout);
+    int64_t byteUs = 10000000LL / (int64_t)baud;
+    if (busyUntilUs < hostSim.nowUs) busyUntilUs = hostSim.nowUs;
+    busyUntilUs += byteUs * (int64_t)n;
+    int64_t blockedUntilUs = busyUntilUs - byteUs * fifoLen;
+    if (blockedUntilUs > hostSim.nowUs) hostSim.nowUs = blockedUntilUs;
+  }
+};
+
+inline HostSerial Serial;
+
+// ---------------------------------------------------------------- IPAddress
+
+class IPAddress {
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : b_{a, b, c, d} {}
+  uint8_t operator[](int i) const { return b_[i]; }
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", b_[0], b_[1], b_[2], b_[3]);
+    return String(buf);
+  }
+
+private:
+  uint8_t b_[4];
+};
+
+// ---------------------------------------------------------------- ESP
+
+class HostEsp {
+public:
+  void restart() { hostSim.restartRequested = true; }
+  uint32_t getFreeHeap() { return 200000; }
+  uint32_t getMinFreeHeap() { return 180000; }
+  uint32_t getMaxAllocHeap() { return 110000; }
+  // Nanoseconds of real time: code under test takes no virtual time
+  uint32_t getCycleCount() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+};
+
+inline HostEsp ESP;
+
+// ---------------------------------------------------------------- FreeRTOS
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+typedef struct HostQueue *QueueHandle_t;
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+// Storage is allocated once, as by FreeRTOS, so sending does not touch the heap
+struct HostQueue {
+  size_t itemSize;
+  size_t length;
+  std::vector<uint8_t> storage;
+  size_t head = 0;
+  size_t count = 0;
+  bool empty() const { return count == 0; }
+};
+
+inline QueueHandle_t xQueueCreate(size_t length, size_t itemSize) {
+  return new HostQueue{itemSize, length, std::vector<uint8_t>(length * itemSize)};
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t) {
+  if (q->count >= q->length) return pdFALSE;
+  size_t slot = (q->head + q->count) % q->length;
+  memcpy(q->storage.data() + slot * q->itemSize, item, q->itemSize);
+  q->count++;
+  return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t) {
+  if (q == NULL || q->empty()) return pdFALSE;
+  memcpy(item, q->storage.data() + q->head * q->itemSize, q->itemSize);
+  q->head = (q->head + 1) % q->length;
+  q->count--;
+  return pdTRUE;
+}
+
+inline BaseType_t xQueueOverwrite(QueueHandle_t q, const void *item) {
+  q->head = 0;
+  q->count = 0;
+  return xQueueSend(q, item, 0);
+}
+
+inline uint32_t uxQueueMessagesWaiting(QueueHandle_t q) { return (uint32_t)q->count; }
+inline uint32_t uxQueueSpacesAvailable(QueueHandle_t q) { return (uint32_t)(q->length - q->count); }
+
+struct HostTask {
+  const char *name;
+  TaskFunction_t fn;
+};
+
+inline std::vector<HostTask> hostTasks;
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t, void *,
+                                          int, TaskHandle_t *handle, int) {
+  hostTasks.push_back({name, fn});
+  if (handle) *handle = (TaskHandle_t)(uintptr_t)hostTasks.size();
+  return pdPASS;
+}
+
+inline void vTaskDelay(TickType_t ticks) { hostSim.nowUs += (int64_t)ticks * 1000; }
+inline uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) {
+  if (hostSim.notifyWait) hostSim.notifyWait();
+  return 1;
+}
+inline void xTaskNotifyGive(TaskHandle_t) {}
+// Everything runs on the replayer's thread, which stands in for the loop task
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return &hostSim; }
+
+struct portMUX_TYPE {
+  int unused;
+};
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,21 @@
+// Host shim: mDNS calls are accepted and ignored
+
+#ifndef HOST_ESPMDNS_H
+#define HOST_ESPMDNS_H
+
+#include "Arduino.h"
+
+class HostMdns {
+public:
+  bool begin(const char *) { return true; }
+  void setInstanceName(const String &) {}
+  void addService(const char *, const char *, uint16_t) {}
+  bool addServiceTxt(const char *, const char *, const char *, const char *) { return true; }
+};
+
+inline HostMdns MDNS;
+
+inline int mdns_hostname_set(const char *) { return 0; }
+inline int mdns_instance_name_set(const char *) { return 0; }
+
+#endif // HOST_ESPMDNS_H
@@ -0,0 +1,64 @@
+// Host shim: an in-memory namespace, empty at start unless the replayer seeds it
+
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include "Arduino.h"
+
+#include <map>
+
+class Preferences {
+public:
+  std::map<std::string, std::vector<uint8_t>> blobs;
+  std::map<std::string, std::string> strings;
+  std::map<std::string, int32_t> ints;
+
+  bool begin(const char *, bool) { return true; }
+  bool clear() {
+    blobs.clear();
+    strings.clear();
+    ints.clear();
+    return true;
+  }
+  bool isKey(const char *key) { return blobs.count(key) || strings.count(key) || ints.count(key); }
+  bool remove(const char *key) {
+    blobs.erase(key);
+    strings.erase(key);
+    ints.erase(key);
+    return true;
+  }
+  size_t putString(const char *key, const String &v) {
+    strings[key] = v.c_str();
+    return v.length();
+  }
+  String getString(const char *key, const String &def = String()) {
+    auto it = strings.find(key);
+    return it == strings.end() ? def : String(it->second);
+  }
+  size_t putInt(const char *key, int32_t v) {
+    ints[key] = v;
+    return 4;
+  }
+  int32_t getInt(const char *key, int32_t def = 0) {
+    auto it = ints.find(key);
+    return it == ints.end() ? def : it->second;
+  }
+  size_t putBytes(const char *key, const void *v, size_t len) {
+    const uint8_t *p = (const uint8_t *)v;
+    blobs[key].assign(p, p + len);
+    return len;
+  }
+  size_t getBytesLength(const char *key) {
+    auto it = blobs.find(key);
+    return it == blobs.end() ? 0 : it->second.size();
+  }
+  size_t getBytes(const char *key, void *buf, size_t len) {
+    auto it = blobs.find(key);
+    if (it == blobs.end()) return 0;
+    size_t n = it->second.size() < len ? it->second.size() : len;
+    memcpy(buf, it->second.data(), n);
+    return n;
+  }
+};
+
+#endif // HOST_PREFERENCES_H
@@ -0,0 +1,39 @@
+// Host shim: the display is not rendered
+
+#ifndef HOST_TFT_ESPI_H
+#define HOST_TFT_ESPI_H
+
+#include "Arduino.h"
+
+#define TFT_BLACK 0x0000
+#define TFT_BLUE 0x001F
+#define TFT_RED 0xF800
+#define TFT_GREEN 0x07E0
+#define TFT_CYAN 0x07FF
+#define TFT_MAGENTA 0xF81F
+#define TFT_YELLOW 0xFFE0
+#define TFT_WHITE 0xFFFF
+#define TFT_ORANGE 0xFDA0
+
+class TFT_eSPI : public Print {
+public:
+  void init() {}
+  void setRotation(uint8_t) {}
+  int16_t width() { return 240; }
+  int16_t height() { return 135; }
+  void write(const char *, size_t) override {}
+};
+
+class TFT_eSprite : public TFT_eSPI {
+public:
+  explicit TFT_eSprite(TFT_eSPI *) {}
+  void *createSprite(int16_t, int16_t) { return this; }
+  void fillSprite(uint32_t) {}
+  void fillRect(int32_t, int32_t, int32_t, int32_t, uint32_t) {}
+  void setTextSize(uint8_t) {}
+  void setTextColor(uint16_t) {}
+  void setCursor(int16_t, int16_t) {}
+  void pushSprite(int32_t, int32_t) {}
+};
+
+#endif // HOST_TFT_ESPI_H
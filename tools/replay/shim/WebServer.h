@@ -0,0 +1,104 @@
+// Host shim: the replayer queues requests and handleClient() dispatches one
+// per call, so they run in the planner's http slot as on the device.
+// Responses are printed.
+
+#ifndef HOST_WEBSERVER_H
+#define HOST_WEBSERVER_H
+
+#include "Arduino.h"
+
+#include <deque>
+#include <utility>
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_POST };
+
+class WebServer {
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  struct Route {
+    String path;
+    HTTPMethod method;
+    THandlerFunction fn;
+  };
+
+  explicit WebServer(int) {}
+
+  void on(const String &path, THandlerFunction fn) { on(path, HTTP_ANY, fn); }
+  void on(const String &path, HTTPMethod method, THandlerFunction fn) {
+    routes_.push_back({path, method, fn});
+  }
+  void begin() {}
+  void handleClient() {
+    if (pending_.empty()) return;
+    std::pair<HTTPMethod, std::string> req = pending_.front();
+    pending_.pop_front();
+    if (!dispatch(req.first, req.second)) Serial.printf("[http] 404 %s\n", uri_.c_str());
+  }
+
+  void queueRequest(HTTPMethod method, const std::string &request) { pending_.push_back({method, request}); }
+
+  // Runs the matching handler for "uri?k=v&..." and returns false on a 404
+  bool dispatch(HTTPMethod method, const std::string &request) {
+    size_t q = request.find('?');
+    uri_ = String(request.substr(0, q));
+    method_ = method;
+    names_.clear();
+    values_.clear();
+    if (q != std::string::npos) {
+      std::string rest = request.substr(q + 1);
+      size_t pos = 0;
+      while (pos <= rest.size()) {
+        size_t amp = rest.find('&', pos);
+        std::string kv = rest.substr(pos, amp == std::string::npos ? std::string::npos : amp - pos);
+        size_t eq = kv.find('=');
+        names_.push_back(String(kv.substr(0, eq)));
+        values_.push_back(String(eq == std::string::npos ? "" : kv.substr(eq + 1)));
+        if (amp == std::string::npos) break;
+        pos = amp + 1;
+      }
+    }
+    for (Route &r : routes_) {
+      if (r.path == uri_ && (r.method == HTTP_ANY || r.method == method)) {
+        r.fn();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  HTTPMethod method() { return method_; }
+  String uri() { return uri_; }
+  int args() { return (int)names_.size(); }
+  String argName(int i) { return names_[i]; }
+  String arg(int i) { return values_[i]; }
+  String arg(const String &name) {
+    for (size_t i = 0; i < names_.size(); i++) {
+      if (names_[i] == name) return values_[i];
+    }
+    return String();
+  }
+  bool hasArg(const String &name) {
+    for (const String &n : names_) {
+      if (n == name) return true;
+    }
+    return false;
+  }
+
+  void sendHeader(const String &, const String &) {}
+  void send(int code, const char *type, const String &body) { send_P(code, type, body.c_str(), body.length()); }
+  void send(int code, const String &type, const String &body) { send(code, type.c_str(), body); }
+  void send_P(int code, const char *type, const char *, size_t len) {
+    Serial.printf("[http] %d %s, %u bytes\n", code, type, (unsigned)len);
+  }
+
+private:
+  std::vector<Route> routes_;
+  std::deque<std::pair<HTTPMethod, std::string>> pending_;
+  HTTPMethod method_ = HTTP_GET;
+  String uri_;
+  std::vector<String> names_;
+  std::vector<String> values_;
+};
+
+#endif // HOST_WEBSERVER_H
@@ -0,0 +1,93 @@
+// Host shim: WiFi link state and scan results are set by the replayer
+
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include "Arduino.h"
+
+typedef enum {
+  ARDUINO_EVENT_WIFI_STA_GOT_IP = 7,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+} arduino_event_id_t;
+
+typedef union {
+  struct {
+    struct {
+      struct {
+        uint32_t addr;
+      } ip;
+    } ip_info;
+  } got_ip;
+  struct {
+    uint8_t reason;
+  } wifi_sta_disconnected;
+} arduino_event_info_t;
+
+typedef void (*WiFiEventSysCb)(arduino_event_id_t, arduino_event_info_t);
+
+enum wl_status_t { WL_IDLE_STATUS = 0, WL_CONNECTED = 3, WL_DISCONNECTED = 6 };
+enum wifi_mode_t { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA };
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+struct HostScanResult {
+  String ssid;
+  int8_t rssi;
+  uint8_t channel;
+};
+
+class HostWiFi {
+public:
+  wl_status_t linkStatus = WL_DISCONNECTED;
+  uint8_t linkChannel = 1;
+  int8_t linkRssi = -60;
+  IPAddress linkIp;
+  uint8_t mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+  bool scanRunning = false;
+  std::vector<HostScanResult> scanResults;
+  bool scanReady = false;
+  std::vector<WiFiEventSysCb> handlers;
+
+  wl_status_t status() { return linkStatus; }
+  void mode(wifi_mode_t) {}
+  void begin(const char *, const char *) {}
+  bool disconnect(bool = false, bool = false) {
+    linkStatus = WL_DISCONNECTED;
+    return true;
+  }
+  void setSleep(bool) {}
+  bool softAP(const char *, const char * = NULL, int = 1, int = 0, int = 4) { return true; }
+  IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+  IPAddress localIP() { return linkStatus == WL_CONNECTED ? linkIp : IPAddress(); }
+  String SSID() { return String(""); }
+  int8_t RSSI() { return linkRssi; }
+  uint8_t channel() { return linkChannel; }
+  uint8_t *macAddress(uint8_t *out) {
+    memcpy(out, mac, 6);
+    return out;
+  }
+
+  int16_t scanNetworks(bool = false, bool = false, bool = false, uint32_t = 300) {
+    scanRunning = true;
+    return WIFI_SCAN_RUNNING;
+  }
+  int16_t scanComplete() {
+    if (scanReady) return (int16_t)scanResults.size();
+    return scanRunning ? WIFI_SCAN_RUNNING : WIFI_SCAN_FAILED;
+  }
+  void scanDelete() {
+    scanResults.clear();
+    scanReady = false;
+    scanRunning = false;
+  }
+  String SSID(int i) { return scanResults[i].ssid; }
+  int8_t RSSI(int i) { return scanResults[i].rssi; }
+  uint8_t channel(int i) { return scanResults[i].channel; }
+
+  void onEvent(WiFiEventSysCb cb) { handlers.push_back(cb); }
+};
+
+inline HostWiFi WiFi;
+
+#endif // HOST_WIFI_H
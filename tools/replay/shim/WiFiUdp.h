@@ -0,0 +1,126 @@
+// Host shim: a real UDP socket, so several replayer instances can receive
+// fleet pushes on a loopback multicast group. Reads never block. Packets
+// the replayer injects from a trace are read before the socket's, with the
+// length they were received with.
+
+#ifndef HOST_WIFI_UDP_H
+#define HOST_WIFI_UDP_H
+
+#include "Arduino.h"
+
+#include <deque>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class WiFiUDP {
+public:
+  ~WiFiUDP() { stop(); }
+
+  // Joins on the loopback interface, where the host tools send
+  uint8_t beginMulticast(IPAddress group, uint16_t port) {
+    stop();
+    fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_ < 0) return 0;
+    int on = 1;
+    setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    ip_mreq mreq = {};
+    mreq.imr_multiaddr.s_addr = toNet(group);
+    mreq.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd_, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+        setsockopt(fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0) {
+      stop();
+      return 0;
+    }
+    return 1;
+  }
+
+  void stop() {
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+  }
+
+  void injectPacket(IPAddress ip, uint16_t port, size_t received, const std::vector<uint8_t> &packet) {
+    sockaddr_in from = {};
+    from.sin_family = AF_INET;
+    from.sin_port = htons(port);
+    from.sin_addr.s_addr = toNet(ip);
+    injected_.push_back({from, received, packet});
+  }
+
+  int parsePacket() {
+    if (!injected_.empty()) {
+      Injected &in = injected_.front();
+      rxLen_ = in.packet.size() < sizeof(rx_) ? in.packet.size() : sizeof(rx_);
+      memcpy(rx_, in.packet.data(), rxLen_);
+      remote_ = in.from;
+      int received = (int)in.received;
+      injected_.pop_front();
+      return received;
+    }
+    if (fd_ < 0) return 0;
+    sockaddr_in from = {};
+    socklen_t fromLen = sizeof(from);
+    ssize_t n = recvfrom(fd_, rx_, sizeof(rx_), MSG_DONTWAIT | MSG_TRUNC, (sockaddr *)&from, &fromLen);
+    if (n <= 0) return 0;
+    rxLen_ = (size_t)n;
+    remote_ = from;
+    return (int)n;
+  }
+
+  int read(uint8_t *buf, size_t len) {
+    size_t n = rxLen_ < sizeof(rx_) ? rxLen_ : sizeof(rx_);
+    if (n > len) n = len;
+    memcpy(buf, rx_, n);
+    return (int)n;
+  }
+
+  IPAddress remoteIP() {
+    uint32_t a = ntohl(remote_.sin_addr.s_addr);
+    return IPAddress(a >> 24, a >> 16, a >> 8, a);
+  }
+  uint16_t remotePort() { return ntohs(remote_.sin_port); }
+
+  int beginPacket(IPAddress ip, uint16_t port) {
+    tx_.clear();
+    to_ = {};
+    to_.sin_family = AF_INET;
+    to_.sin_port = htons(port);
+    to_.sin_addr.s_addr = toNet(ip);
+    return fd_ >= 0;
+  }
+  size_t write(const uint8_t *buf, size_t len) {
+    tx_.insert(tx_.end(), buf, buf + len);
+    return len;
+  }
+  int endPacket() {
+    return sendto(fd_, tx_.data(), tx_.size(), 0, (sockaddr *)&to_, sizeof(to_)) == (ssize_t)tx_.size();
+  }
+
+private:
+  static uint32_t toNet(IPAddress ip) {
+    return htonl((uint32_t)ip[0] << 24 | (uint32_t)ip[1] << 16 | (uint32_t)ip[2] << 8 | ip[3]);
+  }
+
+  struct Injected {
+    sockaddr_in from;
+    size_t received;
+    std::vector<uint8_t> packet;
+  };
+
+  int fd_ = -1;
+  std::deque<Injected> injected_;
+  uint8_t rx_[1500];
+  size_t rxLen_ = 0;
+  sockaddr_in remote_ = {};
+  sockaddr_in to_ = {};
+  std::vector<uint8_t> tx_;
+};
+
+#endif // HOST_WIFI_UDP_H
@@ -0,0 +1,81 @@
+// Host shim: bytes written to the GPS UART are printed as NMEA lines; the
+// line drains at the configured baud rate on the virtual clock.
+
+#ifndef HOST_DRIVER_UART_H
+#define HOST_DRIVER_UART_H
+
+#include "Arduino.h"
+
+typedef int uart_port_t;
+#define UART_NUM_0 0
+#define UART_NUM_1 1
+#define UART_NUM_2 2
+#define UART_NUM_MAX 3
+#define UART_PIN_NO_CHANGE (-1)
+
+typedef enum { UART_DATA_8_BITS = 3 } uart_word_length_t;
+typedef enum { UART_PARITY_DISABLE = 0 } uart_parity_t;
+typedef enum { UART_STOP_BITS_1 = 1 } uart_stop_bits_t;
+typedef enum { UART_HW_FLOWCTRL_DISABLE = 0 } uart_hw_flowcontrol_t;
+typedef enum { UART_SCLK_APB = 0 } uart_sclk_t;
+typedef enum { UART_DATA, UART_BREAK, UART_BUFFER_FULL, UART_FIFO_OVF } uart_event_type_t;
+
+typedef struct {
+  int baud_rate;
+  uart_word_length_t data_bits;
+  uart_parity_t parity;
+  uart_stop_bits_t stop_bits;
+  uart_hw_flowcontrol_t flow_ctrl;
+  uint8_t rx_flow_ctrl_thresh;
+  uart_sclk_t source_clk;
+} uart_config_t;
+
+typedef struct {
+  uart_event_type_t type;
+  size_t size;
+} uart_event_t;
+
+struct HostUart {
+  int baud = 9600;
+  int64_t busyUntilUs = 0;   // Virtual time the last queued byte leaves the wire
+  std::string pendingLine;
+  uint32_t bytesWritten = 0;
+};
+
+inline HostUart hostUart[UART_NUM_MAX];
+
+inline int uart_driver_install(uart_port_t, int, int, int queueSize, QueueHandle_t *queue, int) {
+  if (queue) *queue = xQueueCreate(queueSize, sizeof(uart_event_t));
+  return 0;
+}
+inline int uart_param_config(uart_port_t port, const uart_config_t *cfg) {
+  hostUart[port].baud = cfg->baud_rate;
+  return 0;
+}
+inline int uart_set_pin(uart_port_t, int, int, int, int) { return 0; }
+inline int uart_set_baudrate(uart_port_t port, uint32_t baud) {
+  hostUart[port].baud = (int)baud;
+  return 0;
+}
+inline int uart_flush_input(uart_port_t) { return 0; }
+
+inline int uart_write_bytes(uart_port_t port, const void *data, size_t len) {
+  HostUart &u = hostUart[port];
+  int64_t byteUs = 10000000LL / u.baud;
+  if (u.busyUntilUs < hostSim.nowUs) u.busyUntilUs = hostSim.nowUs;
+  u.busyUntilUs += byteUs * (int64_t)len;
+  u.bytesWritten += len;
+  const char *p = (const char *)data;
+  for (size_t i = 0; i < len; i++) {
+    if (p[i] == '\n') {
+      printf("[nmea %lld.%06lld] %s\n", (long long)(hostSim.nowUs / 1000000),
+                    (long long)(hostSim.nowUs % 1000000), u.pendingLine.c_str());
+      u.pendingLine.clear();
+    } else if (p[i] != '\r') {
+      u.pendingLine += p[i];
+    }
+  }
+  return (int)len;
+}
+
+#endif // HOST_DRIVER_UART_H
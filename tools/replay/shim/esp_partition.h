@@ -0,0 +1,33 @@
+// Host shim: there is no asset partition, so the built-in pages are served
+
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ESP_OK 0
+typedef int esp_err_t;
+
+typedef enum { ESP_PARTITION_TYPE_APP = 0, ESP_PARTITION_TYPE_DATA = 1 } esp_partition_type_t;
+typedef int esp_partition_subtype_t;
+typedef enum { SPI_FLASH_MMAP_DATA, SPI_FLASH_MMAP_INST } spi_flash_mmap_memory_t;
+typedef uint32_t spi_flash_mmap_handle_t;
+
+typedef struct {
+  uint32_t address;
+  uint32_t size;
+} esp_partition_t;
+
+inline const esp_partition_t *esp_partition_find_first(esp_partition_type_t, esp_partition_subtype_t,
+                                                       const char *) {
+  return NULL;
+}
+inline esp_err_t esp_partition_read(const esp_partition_t *, size_t, void *, size_t) { return -1; }
+inline void spi_flash_munmap(spi_flash_mmap_handle_t) {}
+inline esp_err_t esp_partition_mmap(const esp_partition_t *, size_t, size_t, spi_flash_mmap_memory_t,
+                                    const void **, spi_flash_mmap_handle_t *) {
+  return -1;
+}
+
+#endif // HOST_ESP_PARTITION_H
@@ -0,0 +1,21 @@
+// Host shim: SNTP syncs are injected by the replayer through the callback
+
+#ifndef HOST_ESP_SNTP_H
+#define HOST_ESP_SNTP_H
+
+#include "Arduino.h"
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+
+inline sntp_sync_time_cb_t hostSntpCallback = NULL;
+inline uint32_t hostSntpRestarts = 0;
+
+inline void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t cb) { hostSntpCallback = cb; }
+inline void sntp_set_sync_interval(uint32_t) {}
+inline bool sntp_restart() {
+  hostSntpRestarts++;
+  return true;
+}
+inline void configTime(long, int, const char *) {}
+
+#endif // HOST_ESP_SNTP_H
@@ -0,0 +1,10 @@
+// Host shim
+
+#ifndef HOST_ESP_WIFI_H
+#define HOST_ESP_WIFI_H
+
+typedef enum { WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM } wifi_ps_type_t;
+
+inline int esp_wifi_set_ps(wifi_ps_type_t) { return 0; }
+
+#endif // HOST_ESP_WIFI_H
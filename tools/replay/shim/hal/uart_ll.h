@@ -0,0 +1,16 @@
+// Host shim: the TX line state follows the virtual clock
+
+#ifndef HOST_HAL_UART_LL_H
+#define HOST_HAL_UART_LL_H
+
+#include "driver/uart.h"
+
+#define UART_LL_GET_HW(port) (&hostUart[port])
+
+inline bool uart_ll_is_tx_idle(HostUart *u) { return hostSim.nowUs >= u->busyUntilUs; }
+
+// Free FIFO space: the host model treats everything queued as already in the
+// ring buffer, so the FIFO always looks empty.
+inline uint32_t uart_ll_get_txfifo_len(HostUart *) { return 128; }
+
+#endif // HOST_HAL_UART_LL_H
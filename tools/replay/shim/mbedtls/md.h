@@ -0,0 +1,114 @@
+// Host shim: the HMAC-SHA256 subset of mbedTLS' generic message digest API,
+// so the replayer builds without mbedTLS installed
+
+#ifndef HOST_MBEDTLS_MD_H
+#define HOST_MBEDTLS_MD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef enum { MBEDTLS_MD_NONE = 0, MBEDTLS_MD_SHA256 = 6 } mbedtls_md_type_t;
+
+struct mbedtls_md_info_t {
+  mbedtls_md_type_t type;
+};
+
+inline const mbedtls_md_info_t *mbedtls_md_info_from_type(mbedtls_md_type_t type) {
+  static const mbedtls_md_info_t sha256 = {MBEDTLS_MD_SHA256};
+  return type == MBEDTLS_MD_SHA256 ? &sha256 : NULL;
+}
+
+struct HostSha256 {
+  uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  uint8_t block[64];
+  size_t used = 0;
+  uint64_t bytes = 0;
+
+  static uint32_t ror(uint32_t x, int n) { return x >> n | x << (32 - n); }
+
+  void compress() {
+    static const uint32_t k[64] = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+      0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+      0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+      0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+      0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+      w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 |
+             (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+      uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+    for (int i = 0; i < 64; i++) {
+      uint32_t t1 = hh + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+      uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+      hh = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+  }
+
+  void update(const uint8_t *p, size_t len) {
+    bytes += len;
+    while (len > 0) {
+      size_t n = 64 - used < len ? 64 - used : len;
+      memcpy(block + used, p, n);
+      used += n;
+      p += n;
+      len -= n;
+      if (used == 64) {
+        compress();
+        used = 0;
+      }
+    }
+  }
+
+  void finish(uint8_t out[32]) {
+    uint64_t bits = bytes * 8;
+    uint8_t pad = 0x80;
+    update(&pad, 1);
+    pad = 0;
+    while (used != 56) update(&pad, 1);
+    uint8_t len[8];
+    for (int i = 0; i < 8; i++) len[i] = (uint8_t)(bits >> (56 - 8 * i));
+    update(len, 8);
+    for (int i = 0; i < 32; i++) out[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+  }
+};
+
+inline int mbedtls_md_hmac(const mbedtls_md_info_t *info, const unsigned char *key, size_t keylen,
+                           const unsigned char *input, size_t ilen, unsigned char *output) {
+  if (info == NULL || info->type != MBEDTLS_MD_SHA256) return -1;
+  uint8_t k[64] = {};
+  if (keylen > 64) {
+    HostSha256 kh;
+    kh.update(key, keylen);
+    kh.finish(k);
+  } else {
+    memcpy(k, key, keylen);
+  }
+  uint8_t pad[64];
+  HostSha256 inner;
+  for (int i = 0; i < 64; i++) pad[i] = k[i] ^ 0x36;
+  inner.update(pad, 64);
+  inner.update(input, ilen);
+  uint8_t innerHash[32];
+  inner.finish(innerHash);
+  HostSha256 outer;
+  for (int i = 0; i < 64; i++) pad[i] = k[i] ^ 0x5c;
+  outer.update(pad, 64);
+  outer.update(innerHash, 32);
+  outer.finish(output);
+  return 0;
+}
+
+#endif // HOST_MBEDTLS_MD_H
@@ -0,0 +1,31 @@
+// Fills the static portal page from /config.json
+fetch('/config.json').then(function (r) { return r.json(); }).then(function (c) {
+  var select = document.getElementById('ssid');
+  var seen = {};
+  c.networks.forEach(function (n) {
+    var o = document.createElement('option');
+    o.value = n.ssid;
+    o.textContent = n.ssid + ' (' + n.rssi + 'dBm)';
+    o.selected = n.ssid === c.ssid;
+    seen[n.ssid] = true;
+    select.appendChild(o);
+  });
+  if (c.ssid && !seen[c.ssid]) {
+    var o = document.createElement('option');
+    o.value = c.ssid;
+    o.textContent = c.ssid;
+    o.selected = true;
+    select.appendChild(o);
+  }
+  if (c.scanning) {
+    var s = document.createElement('option');
+    s.disabled = true;
+    s.textContent = 'Scanning, reload to refresh';
+    select.appendChild(s);
+  }
+  document.getElementById('hostname').value = c.hostname;
+  document.getElementById('ntpserver').value = c.ntpserver;
+  document.getElementById('baudrate').value = c.baudrate;
+  document.getElementById('rotation').value = c.rotation;
+  document.getElementById('nmea').value = c.nmea;
+});